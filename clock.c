@@ -0,0 +1,33 @@
+/**************************************************************************
+ *
+ * CLOCK.C - Free-running Timer1 time base
+ * See clock.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "clock.h"
+
+// Start Timer1 in normal mode at F_CPU/8
+void clock_init(void)
+{
+	TCCR1A = 0;
+	TCCR1B = _BV(CS11);
+}
+
+// Timestamp for main code, see CLOCK_NOW()
+uint16_t clock_now(void)
+{
+	uint8_t sreg = SREG;
+	uint16_t t;
+
+	cli();
+	t = CLOCK_NOW();
+	SREG = sreg;
+	return t;
+}
@@ -0,0 +1,35 @@
+/**************************************************************************
+ *
+ * CLOCK.H - Free-running Timer1 time base definitions
+ * Timer1 counts at F_CPU/8 and is never stopped or reloaded, so any code
+ * can take a 16 bit timestamp and subtract two of them to get an elapsed
+ * time (1 us per tick at 8 MHz, wraps after 65 ms).
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#define CLOCK_PRESCALE	8
+#define CLOCK_HZ	(F_CPU / CLOCK_PRESCALE)
+
+// Current timestamp, for ISRs and code with interrupts off. TCNT1 is read
+// low byte first and the high byte comes from a latch shared by all 16 bit
+// Timer1 registers, so an ISR reading it in between spoils the result; main
+// code uses clock_now().
+#define CLOCK_NOW()	TCNT1
+
+// Convert microseconds to clock ticks
+#define CLOCK_US(us)	((uint16_t)((us) * (CLOCK_HZ / 1000UL) / 1000UL))
+
+void clock_init(void);
+uint16_t clock_now(void);
+
+#endif //__CLOCK_H__
@@ -0,0 +1,40 @@
+/**************************************************************************
+ *
+ * HAL.H - Hardware abstraction for ps2_term
+ * Picks a board profile for the MCU being compiled for (MCU in the
+ * Makefile). A profile maps the USART, external interrupt and timer
+ * registers onto the HAL_ names used by the rest of the code, may move
+ * the LCD pins (see lcd_norw.h) and sizes the RAM buffers for the part.
+ * Anything a profile leaves out keeps the Tiny4313 default from the
+ * module headers.
+ *
+ * To add a part, copy the closest hal_*.h and add it below.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include <avr/io.h>
+
+#if defined(__AVR_ATtiny4313__)
+#include "hal_t4313.h"
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
+#include "hal_m328p.h"
+#elif defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284__)
+#include "hal_m1284p.h"
+#else
+#error "No board profile for this MCU, see hal.h"
+#endif
+
+// Variables kept across a watchdog reset, see wdog.h. They can't have
+// initializers; they start at 0 after power-on.
+#define NOINIT	__attribute__ ((section (".noinit")))
+
+// USART baud rate register value, rounded to the nearest rate
+#define HAL_UBRR(baud)	((F_CPU + 8UL * (baud)) / (16UL * (baud)) - 1)
+
+#endif //__HAL_H__
@@ -0,0 +1,101 @@
+/**************************************************************************
+ *
+ * HAL_M328P.H - Board profile: ATmega328P
+ * 2 KB of SRAM and 32 KB of flash, so the queues are larger and the
+ * binary screen protocol is built in. PB6/PB7 usually carry the crystal,
+ * so the LCD moves to PORTC:
+ *
+ *   D4-D7  PC0-PC3    RS  PC4    E  PC5    RW  PB0 (tie low)    E2  PD5
+ *
+ * The PS/2 keyboard stays on PD3 (INT1) and PD4.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HAL_M328P_H__
+#define __HAL_M328P_H__
+
+#define HAL_RAM_SIZE		2048
+
+// USART0
+#define HAL_UDR			UDR0
+#define HAL_UCSRA		UCSR0A
+#define HAL_UCSRB		UCSR0B
+#define HAL_UBRRL		UBRR0L
+#define HAL_UBRRH		UBRR0H
+#define HAL_RXEN		RXEN0
+#define HAL_TXEN		TXEN0
+#define HAL_RXCIE		RXCIE0
+#define HAL_UDRIE		UDRIE0
+#define HAL_UDRE		UDRE0
+#define HAL_DOR			DOR0
+#define HAL_FE			FE0
+#define HAL_USART_RX_vect	USART_RX_vect
+#define HAL_USART_UDRE_vect	USART_UDRE_vect
+#define HAL_USART_TX_vect	USART_TX_vect
+
+// USART 9 bit multi-processor mode (RS485)
+#define HAL_UCSZ2		UCSZ02
+#define HAL_RXB8		RXB80
+#define HAL_TXB8		TXB80
+#define HAL_MPCM		MPCM0
+#define HAL_TXCIE		TXCIE0
+#define HAL_TXC			TXC0
+
+// RXD pin, read directly by the oscillator calibration
+#define HAL_RXD_PIN		PIND
+#define HAL_RXD_BIT		PD0
+
+// OSCCAL bits that tune within one range; bit 7 picks one of two
+// overlapping ranges, so frequency jumps between 0x7F and 0x80
+#define HAL_OSCCAL_RANGE	0x7F
+
+// External interrupt INT1 (PS/2 clock on PD3)
+#define HAL_EICR		EICRA
+#define HAL_EIMSK		EIMSK
+#define HAL_ISC11		ISC11
+#define HAL_INT1		INT1
+#define HAL_EIFR		EIFR
+#define HAL_INTF1		INTF1
+#define HAL_INT1_vect		INT1_vect
+
+// Timer0 interrupt mask and flag registers
+#define HAL_TIMSK0		TIMSK0
+#define HAL_TIFR0		TIFR0
+
+// LCD pins
+#define LCD_PORT		PORTC
+#define LCD_DATA0_PORT		PORTC
+#define LCD_DATA1_PORT		PORTC
+#define LCD_DATA2_PORT		PORTC
+#define LCD_DATA3_PORT		PORTC
+#define LCD_DATA0_PIN		0
+#define LCD_DATA1_PIN		1
+#define LCD_DATA2_PIN		2
+#define LCD_DATA3_PIN		3
+#define LCD_RS_PORT		PORTC
+#define LCD_RS_PIN		4
+#define LCD_RW_PORT		PORTB
+#define LCD_RW_PIN		0
+#define LCD_E_PORT		PORTC
+#define LCD_E_PIN		5
+#define LCD_E2_PORT		PORTD
+#define LCD_E2_PIN		5
+
+// Buffer sizes and features
+#define KBD_BUFSIZE		32
+#define KBD_EVSIZE		8
+#define KBD_EVTIME
+#define TRACE_SIZE		32
+#define RX_BUFSIZE		64
+#define UART_TX_BUFSIZE		32
+#define DISP_BUFSIZE		32
+#define SCREEN_PROTO
+#define LATENCY
+#define REPLAY
+#define UTF8
+#define REC_SIZE		256
+
+#endif //__HAL_M328P_H__
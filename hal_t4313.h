@@ -0,0 +1,99 @@
+/**************************************************************************
+ *
+ * HAL_T4313.H - Board profile: ATtiny4313 on the Futurlec ET-JRAVR board
+ * 256 bytes of SRAM and 4 KB of flash, so all buffers stay at their
+ * minimum and the optional features are left off. The LCD sits on the
+ * J8 connector (PORTB, see lcd_norw.h).
+ *
+ * KBD_USI board option: the PS/2 clock is also wired to PB7 (USCK) and the
+ * data to PB5 (DI), so the USI shifts the frames in and the keyboard costs
+ * two interrupts per byte instead of eleven. PD3/PD4 stay connected, they
+ * are used for sending to the keyboard. PB6 (DO) must be left open. The
+ * LCD moves off PB4-PB7:
+ *
+ *   D4-D7  PB0-PB3    RS  PB4    E  PD6    RW  PA0 (tie low)    E2  PD5
+ *
+ * E on PD6 rules out TRACE_PIN PD6 (see trace.h).
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HAL_T4313_H__
+#define __HAL_T4313_H__
+
+#define HAL_RAM_SIZE		256
+
+// USART
+#define HAL_UDR			UDR
+#define HAL_UCSRA		UCSRA
+#define HAL_UCSRB		UCSRB
+#define HAL_UBRRL		UBRRL
+#define HAL_UBRRH		UBRRH
+#define HAL_RXEN		RXEN
+#define HAL_TXEN		TXEN
+#define HAL_RXCIE		RXCIE
+#define HAL_UDRIE		UDRIE
+#define HAL_UDRE		UDRE
+#define HAL_DOR			DOR
+#define HAL_FE			FE
+#define HAL_USART_RX_vect	USART_RX_vect
+#define HAL_USART_UDRE_vect	USART_UDRE_vect
+#define HAL_USART_TX_vect	USART_TX_vect
+
+// USART 9 bit multi-processor mode (RS485)
+#define HAL_UCSZ2		UCSZ2
+#define HAL_RXB8		RXB8
+#define HAL_TXB8		TXB8
+#define HAL_MPCM		MPCM
+#define HAL_TXCIE		TXCIE
+#define HAL_TXC			TXC
+
+// RXD pin, read directly by the oscillator calibration
+#define HAL_RXD_PIN		PIND
+#define HAL_RXD_BIT		PD0
+
+// OSCCAL bits that tune within one range; the tiny has a single range
+#define HAL_OSCCAL_RANGE	0x7F
+
+// External interrupt INT1 (PS/2 clock on PD3)
+#define HAL_EICR		MCUCR
+#define HAL_EIMSK		GIMSK
+#define HAL_ISC11		ISC11
+#define HAL_INT1		INT1
+#define HAL_EIFR		EIFR
+#define HAL_INTF1		INTF1
+#define HAL_INT1_vect		INT1_vect
+
+// Timer0 interrupt mask and flag registers
+#define HAL_TIMSK0		TIMSK
+#define HAL_TIFR0		TIFR
+
+// USI, for KBD_USI and LCD_SERIAL
+#define HAL_USI_OVF_vect	USI_OVERFLOW_vect
+
+//#define KBD_USI
+
+#ifdef KBD_USI
+// LCD pins, moved for the USI
+#define LCD_PORT		PORTB
+#define LCD_DATA0_PORT		PORTB
+#define LCD_DATA1_PORT		PORTB
+#define LCD_DATA2_PORT		PORTB
+#define LCD_DATA3_PORT		PORTB
+#define LCD_DATA0_PIN		0
+#define LCD_DATA1_PIN		1
+#define LCD_DATA2_PIN		2
+#define LCD_DATA3_PIN		3
+#define LCD_RS_PORT		PORTB
+#define LCD_RS_PIN		4
+#define LCD_RW_PORT		PORTA
+#define LCD_RW_PIN		0
+#define LCD_E_PORT		PORTD
+#define LCD_E_PIN		6
+#define LCD_E2_PORT		PORTD
+#define LCD_E2_PIN		5
+#endif
+
+#endif //__HAL_T4313_H__
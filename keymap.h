@@ -0,0 +1,90 @@
+/* keymap.h - generated by keymaps/mkkeymap.py from keymaps/us.kmap, do not edit.
+ * Included by ps2kbd.c only.
+ */
+
+#define	KMAP_SIZE	0x84		/* Entries in the direct-indexed tables */
+#define	KMAP_SEQ_BASE	0x80		/* First code that selects a sequence */
+#define	KMAP_SEQ_MAX	32		/* Codes reserved for sequences */
+#define	KMAP_SEQ_N	22		/* Sequences in kmap_seq_offs */
+#define	KMAP_LAYOUTS	1
+
+#define	KMAP_US		0
+
+// Table indices within a layout
+
+#define	KMAP_NORMAL	0
+#define	KMAP_SHIFT	1
+#define	KMAP_CAPS	2
+#define	KMAP_ALTGR	3
+#define	KMAP_KEYPAD	4
+#define	KMAP_EXTENDED	5
+
+static const unsigned char kmap_seq_offs[] PROGMEM = {
+	0x00, 0x04, 0x08, 0x0c, 0x10, 0x15, 0x1a, 0x1f, 0x24, 0x29, 0x2e, 0x32,
+	0x36, 0x3a, 0x3e, 0x44, 0x4a, 0x50, 0x56, 0x5c, 0x62, 0x68,
+};
+
+static const unsigned char kmap_seq[] PROGMEM = {
+	0x1b, 0x5b, 0x41, 0x00, 0x1b, 0x5b, 0x42, 0x00, 0x1b, 0x5b, 0x43, 0x00,
+	0x1b, 0x5b, 0x44, 0x00, 0x1b, 0x5b, 0x31, 0x7e, 0x00, 0x1b, 0x5b, 0x32,
+	0x7e, 0x00, 0x1b, 0x5b, 0x33, 0x7e, 0x00, 0x1b, 0x5b, 0x34, 0x7e, 0x00,
+	0x1b, 0x5b, 0x35, 0x7e, 0x00, 0x1b, 0x5b, 0x36, 0x7e, 0x00, 0x1b, 0x4f,
+	0x50, 0x00, 0x1b, 0x4f, 0x51, 0x00, 0x1b, 0x4f, 0x52, 0x00, 0x1b, 0x4f,
+	0x53, 0x00, 0x1b, 0x5b, 0x31, 0x35, 0x7e, 0x00, 0x1b, 0x5b, 0x31, 0x37,
+	0x7e, 0x00, 0x1b, 0x5b, 0x31, 0x38, 0x7e, 0x00, 0x1b, 0x5b, 0x31, 0x39,
+	0x7e, 0x00, 0x1b, 0x5b, 0x32, 0x30, 0x7e, 0x00, 0x1b, 0x5b, 0x32, 0x31,
+	0x7e, 0x00, 0x1b, 0x5b, 0x32, 0x33, 0x7e, 0x00, 0x1b, 0x5b, 0x32, 0x34,
+	0x7e, 0x00,
+};
+
+static const unsigned char kmap_us_normal[] PROGMEM = {
+	0x00, 0x92, 0x00, 0x8e, 0x8c, 0x8a, 0x8b, 0x95, 0x00, 0x93, 0x91, 0x8f,
+	0x8d, 0x09, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x71, 0x31, 0x00,
+	0x00, 0x00, 0x7a, 0x73, 0x61, 0x77, 0x32, 0x00, 0x00, 0x63, 0x78, 0x64,
+	0x65, 0x34, 0x33, 0x00, 0x00, 0x20, 0x76, 0x66, 0x74, 0x72, 0x35, 0x00,
+	0x00, 0x6e, 0x62, 0x68, 0x67, 0x79, 0x36, 0x00, 0x00, 0x00, 0x6d, 0x6a,
+	0x75, 0x37, 0x38, 0x00, 0x00, 0x2c, 0x6b, 0x69, 0x6f, 0x30, 0x39, 0x00,
+	0x00, 0x2e, 0x2f, 0x6c, 0x3b, 0x70, 0x2d, 0x00, 0x00, 0x00, 0x27, 0x00,
+	0x5b, 0x3d, 0x00, 0x00, 0x00, 0x00, 0x0d, 0x5d, 0x00, 0x5c, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x87, 0x00, 0x83,
+	0x84, 0x00, 0x00, 0x00, 0x85, 0x86, 0x81, 0x00, 0x82, 0x80, 0x1b, 0x00,
+	0x94, 0x2b, 0x89, 0x2d, 0x2a, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90,
+};
+
+static const unsigned char kmap_us_shift[] PROGMEM = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x09, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x51, 0x21, 0x00,
+	0x00, 0x00, 0x5a, 0x53, 0x41, 0x57, 0x40, 0x00, 0x00, 0x43, 0x58, 0x44,
+	0x45, 0x24, 0x23, 0x00, 0x00, 0x20, 0x56, 0x46, 0x54, 0x52, 0x25, 0x00,
+	0x00, 0x4e, 0x42, 0x48, 0x47, 0x59, 0x5e, 0x00, 0x00, 0x00, 0x4d, 0x4a,
+	0x55, 0x26, 0x2a, 0x00, 0x00, 0x3c, 0x4b, 0x49, 0x4f, 0x29, 0x28, 0x00,
+	0x00, 0x3e, 0x3f, 0x4c, 0x3a, 0x50, 0x5f, 0x00, 0x00, 0x00, 0x22, 0x00,
+	0x7b, 0x2b, 0x00, 0x00, 0x00, 0x00, 0x0d, 0x7d, 0x00, 0x7c, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x2b, 0x00, 0x2d, 0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const unsigned char kmap_us_caps[] PROGMEM = {
+	0x00, 0x00, 0x20, 0x3c, 0x1e, 0x3c, 0x3e, 0x1c, 0x1c, 0x28, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const unsigned char kmap_us_altgr[] PROGMEM = {
+	0x00, 0x00,
+};
+
+static const unsigned char kmap_us_keypad[] PROGMEM = {
+	0x70, 0x30, 0x69, 0x31, 0x72, 0x32, 0x7a, 0x33, 0x6b, 0x34, 0x73, 0x35,
+	0x74, 0x36, 0x6c, 0x37, 0x75, 0x38, 0x7d, 0x39, 0x71, 0x2e, 0x00, 0x00,
+};
+
+static const unsigned char kmap_us_extended[] PROGMEM = {
+	0x4a, 0x2f, 0x5a, 0x0d, 0x70, 0x85, 0x71, 0x86, 0x6c, 0x84, 0x69, 0x87,
+	0x7d, 0x88, 0x7a, 0x89, 0x75, 0x80, 0x72, 0x81, 0x6b, 0x83, 0x74, 0x82,
+	0x00, 0x00,
+};
+
+static const unsigned char * const kmap_layouts[KMAP_LAYOUTS][6] PROGMEM = {
+	{ kmap_us_normal, kmap_us_shift, kmap_us_caps, kmap_us_altgr, kmap_us_keypad, kmap_us_extended },
+};
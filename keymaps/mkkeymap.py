@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+#
+# mkkeymap.py - Keymap compiler for ps2_term. Reads the vt100.kseq sequence
+# list and one or more *.kmap layout files and writes a C header with the
+# PROGMEM lookup tables used by ps2kbd.c. The first layout given is the
+# default one, the others can be picked at run time from EEPROM.
+#
+# usage: python3 mkkeymap.py us.kmap [uk.kmap de.kmap ...] > keymap.h
+#
+# (C) 2012 KB4OID Labs, a division of Kodetroll Heavy Industries.
+#
+
+import os
+import sys
+
+KMAP_SIZE = 0x84		# highest set 2 scancode is 0x83 (F7)
+KMAP_SEQ_BASE = 0x80		# codes 0x80..0x9f select a sequence
+KMAP_SEQ_MAX = 32
+
+CONTROLS = {'sp': 0x20, 'tab': 0x09, 'cr': 0x0d, 'bs': 0x08, 'esc': 0x1b}
+
+
+def fail(where, msg):
+	sys.exit('%s: %s' % (where, msg))
+
+
+def read_lines(path):
+	with open(path, encoding='utf-8') as f:
+		for n, line in enumerate(f, 1):
+			line = line.rstrip('\r\n')
+			if line.strip() and not line.lstrip().startswith('#'):
+				yield '%s:%d' % (path, n), line.split()
+
+
+def read_sequences(path):
+	seqs = []
+	for where, f in read_lines(path):
+		if len(f) != 2:
+			fail(where, 'expected "name bytes"')
+		seqs.append((f[0], f[1].replace('\\e', '\x1b').encode('latin-1')))
+	if len(seqs) > KMAP_SEQ_MAX:
+		fail(path, 'more than %d sequences' % KMAP_SEQ_MAX)
+	return seqs
+
+
+def code(where, tok, seqnames):
+	if tok == '--':
+		return 0
+	if len(tok) == 1:
+		try:
+			c = tok.encode('latin-1')[0]
+		except UnicodeEncodeError:
+			fail(where, '%r is not a Latin-1 character' % tok)
+		if KMAP_SEQ_BASE <= c < KMAP_SEQ_BASE + KMAP_SEQ_MAX:
+			fail(where, 'byte 0x%02x is reserved for sequences' % c)
+		return c
+	if tok.startswith('0x'):
+		c = int(tok, 16)
+		if KMAP_SEQ_BASE <= c < KMAP_SEQ_BASE + KMAP_SEQ_MAX:
+			fail(where, 'byte 0x%02x is reserved for sequences, use @name' % c)
+		return c
+	if tok.startswith('@'):
+		name = tok[1:]
+		if name in CONTROLS:
+			return CONTROLS[name]
+		if name in seqnames:
+			return KMAP_SEQ_BASE + seqnames.index(name)
+	fail(where, 'unknown key token %r' % tok)
+
+
+def is_caps(normal, shift):
+	# Letters, including Latin-1 ones, follow CAPS LOCK
+	n = bytes([normal]).decode('latin-1')
+	s = bytes([shift]).decode('latin-1')
+	return n.isalpha() and n.upper() == s
+
+
+def read_layout(path, seqnames):
+	lay = {
+		'normal': [0] * KMAP_SIZE,
+		'shift': [0] * KMAP_SIZE,
+		'caps': [0] * ((KMAP_SIZE + 7) // 8),
+		'altgr': [],
+		'keypad': [],
+		'extended': [],
+	}
+	section = 'main'
+	for where, f in read_lines(path):
+		if f[0].startswith('['):
+			section = f[0].strip('[]')
+			if section not in ('keypad', 'extended'):
+				fail(where, 'unknown section %r' % f[0])
+			continue
+		sc = int(f[0], 16)
+		if not 0 < sc < KMAP_SIZE:
+			fail(where, 'scancode 0x%02x out of range' % sc)
+		c = [code(where, t, seqnames) for t in f[1:]]
+		if section == 'extended':
+			if len(c) != 1:
+				fail(where, 'extended keys take one entry')
+			lay['extended'] += [sc, c[0]]
+			continue
+		if section == 'keypad':
+			if len(c) != 2:
+				fail(where, 'keypad keys take numlock-off and numlock-on entries')
+			lay['normal'][sc] = c[0]
+			if c[1]:
+				lay['keypad'] += [sc, c[1]]
+			continue
+		if not 1 <= len(c) <= 3:
+			fail(where, 'expected "sc normal [shift [altgr]]"')
+		c += [0] * (3 - len(c))
+		lay['normal'][sc] = c[0]
+		lay['shift'][sc] = c[1]
+		if c[2]:
+			lay['altgr'] += [sc, c[2]]
+		if is_caps(c[0], c[1]):
+			lay['caps'][sc >> 3] |= 1 << (sc & 7)
+	return lay
+
+
+def emit_table(out, name, data):
+	out.append('static const unsigned char %s[] PROGMEM = {' % name)
+	for i in range(0, len(data), 12):
+		out.append('\t' + ' '.join('0x%02x,' % b for b in data[i:i + 12]))
+	out.append('};')
+	out.append('')
+
+
+def main(argv):
+	if len(argv) < 2:
+		sys.exit('usage: %s layout.kmap [layout.kmap ...]' % argv[0])
+
+	here = os.path.dirname(os.path.abspath(__file__))
+	seqs = read_sequences(os.path.join(here, 'vt100.kseq'))
+	seqnames = [s[0] for s in seqs]
+	names = [os.path.splitext(os.path.basename(p))[0] for p in argv[1:]]
+	layouts = [read_layout(p, seqnames) for p in argv[1:]]
+
+	out = [
+		'/* keymap.h - generated by keymaps/mkkeymap.py from %s, do not edit.' % ' '.join(argv[1:]),
+		' * Included by ps2kbd.c only.',
+		' */',
+		'',
+		'#define\tKMAP_SIZE\t0x%02x\t\t/* Entries in the direct-indexed tables */' % KMAP_SIZE,
+		'#define\tKMAP_SEQ_BASE\t0x%02x\t\t/* First code that selects a sequence */' % KMAP_SEQ_BASE,
+		'#define\tKMAP_SEQ_MAX\t%d\t\t/* Codes reserved for sequences */' % KMAP_SEQ_MAX,
+		'#define\tKMAP_SEQ_N\t%d\t\t/* Sequences in kmap_seq_offs */' % len(seqs),
+		'#define\tKMAP_LAYOUTS\t%d' % len(layouts),
+		'',
+	]
+	for i, n in enumerate(names):
+		out.append('#define\tKMAP_%s\t\t%d' % (n.upper(), i))
+	out.append('')
+	out.append('// Table indices within a layout')
+	out.append('')
+	for i, t in enumerate(('NORMAL', 'SHIFT', 'CAPS', 'ALTGR', 'KEYPAD', 'EXTENDED')):
+		out.append('#define\tKMAP_%s\t%s%d' % (t, '\t' if len(t) < 4 else '', i))
+	out.append('')
+
+	# Sequences: NUL terminated strings plus an offset table
+	blob = []
+	offs = []
+	for name, b in seqs:
+		offs.append(len(blob))
+		blob += list(b) + [0]
+	if len(blob) > 255:
+		fail('vt100.kseq', 'sequences take more than 255 bytes')
+	emit_table(out, 'kmap_seq_offs', offs)
+	emit_table(out, 'kmap_seq', blob)
+
+	for n, lay in zip(names, layouts):
+		for t in ('normal', 'shift', 'caps'):
+			emit_table(out, 'kmap_%s_%s' % (n, t), lay[t])
+		for t in ('altgr', 'keypad', 'extended'):
+			emit_table(out, 'kmap_%s_%s' % (n, t), lay[t] + [0, 0])
+
+	out.append('static const unsigned char * const kmap_layouts[KMAP_LAYOUTS][6] PROGMEM = {')
+	for n in names:
+		out.append('\t{ ' + ', '.join('kmap_%s_%s' % (n, t) for t in
+			('normal', 'shift', 'caps', 'altgr', 'keypad', 'extended')) + ' },')
+	out.append('};')
+
+	sys.stdout.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+	main(sys.argv)
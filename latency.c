@@ -0,0 +1,135 @@
+/**************************************************************************
+ *
+ * LATENCY.C - Latency histograms
+ * See latency.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "latency.h"
+#include "uart.h"
+#include "ascii.h"
+
+#ifdef LATENCY
+
+volatile uint16_t lat_hist[2][LAT_BUCKETS];
+volatile uint16_t lat_frame_t = 0;
+volatile uint16_t lat_key_t0 = 0;
+volatile uint8_t lat_key_slot = 0;
+volatile uint8_t lat_key_on = 0;
+volatile uint16_t lat_rx_t0 = 0;
+volatile uint8_t lat_rx_slot = 0;
+volatile uint8_t lat_rx_on = 0;
+uint16_t lat_worst[2];
+uint8_t lat_worst_in[2];
+uint16_t lat_run_t0 = 0;
+
+// Adds a sample that started at t0 to histogram h. Called from ISRs and,
+// with interrupts off, from main code, see CLOCK_NOW().
+void lat_record(uint8_t h, uint16_t t0)
+{
+	uint16_t t = CLOCK_NOW() - t0;
+	uint8_t b = 0;
+
+	for (t >>= 5; t && b < LAT_BUCKETS - 1; t >>= 1)
+		b++;
+
+	if (lat_hist[h][b] != 0xFFFF)
+		lat_hist[h][b]++;
+}
+
+// Times the next byte queued for TX from the end of the last PS/2 frame
+void lat_key_mark(void)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	if (!lat_key_on)
+	{
+		lat_key_t0 = lat_frame_t;
+		lat_key_slot = tx_head;
+		lat_key_on = 1;
+	}
+	SREG = sreg;
+}
+
+// Completes the LAT_DISP sample if the byte being processed is timed
+void lat_displayed(void)
+{
+	uint8_t sreg = SREG;
+
+	if (lat_rx_on != 2)
+		return;
+
+	cli();
+	lat_record(LAT_DISP, lat_rx_t0);
+	lat_rx_on = 0;
+	SREG = sreg;
+}
+
+// Ends a task run started with LAT_RUN_START(), keeping it if it is the
+// longest so far
+void lat_run_end(uint8_t h, uint8_t in)
+{
+	uint16_t t = clock_now() - lat_run_t0;
+
+	if (t > lat_worst[h])
+	{
+		lat_worst[h] = t;
+		lat_worst_in[h] = in;
+	}
+}
+
+// Sends both histograms to the serial port and clears them, as
+// "K cccc cccc ..." for LAT_KEY and "D cccc cccc ..." for LAT_DISP,
+// bucket 0 first, then the longest task runs and clears those, as
+// "W tttt bb tttt bb" for task_kbd and task_rx.
+void lat_report(void)
+{
+	uint8_t h, b;
+	uint16_t n;
+	uint8_t sreg;
+
+	for (h = 0; h < 2; h++)
+	{
+		UART_putc(h == LAT_KEY ? 'K' : 'D');
+		for (b = 0; b < LAT_BUCKETS; b++)
+		{
+			sreg = SREG;
+			cli();
+			n = lat_hist[h][b];
+			lat_hist[h][b] = 0;
+			SREG = sreg;
+
+			UART_putc(' ');
+			UART_puthex(n >> 8);
+			UART_puthex(n);
+		}
+		UART_putc(CR);
+		UART_putc(LF);
+	}
+
+	UART_putc('W');
+	for (h = 0; h < 2; h++)
+	{
+		UART_putc(' ');
+		UART_puthex(lat_worst[h] >> 8);
+		UART_puthex(lat_worst[h]);
+		UART_putc(' ');
+		UART_puthex(lat_worst_in[h]);
+		lat_worst[h] = 0;
+	}
+	UART_putc(CR);
+	UART_putc(LF);
+
+	// don't count the report in the task_rx run that sent it
+	lat_run_t0 = clock_now();
+}
+
+#endif
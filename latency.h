@@ -0,0 +1,115 @@
+/**************************************************************************
+ *
+ * LATENCY.H - Latency histogram definitions
+ * Optional end-to-end latency measurement on the two paths that matter:
+ *
+ *   LAT_KEY   end of the PS/2 frame that completed a key, to the byte
+ *             being loaded into UDR
+ *   LAT_DISP  byte complete in UDR, to the display queue having drawn
+ *             it (for a CR, the whole redraw)
+ *
+ * Both edges are Timer1 timestamps (see clock.h). One byte per path is
+ * measured at a time, later ones are skipped until it completes.
+ * Samples go into log-scale histograms of LAT_BUCKETS counters:
+ *
+ *   bucket 0    under 32 ticks
+ *   bucket n    32 << (n-1) up to 32 << n ticks
+ *   bucket 11   32768 ticks or more
+ *
+ * The host reads and clears them with ESC CMD_LATENCY. Counters stick
+ * at 0xFFFF. Timer1 wraps after 65536 ticks, so longer latencies land
+ * in a wrong, lower bucket.
+ *
+ * The same report gives the longest single run of task_kbd (PS/2
+ * decoding) and task_rx (host byte decoding) since the last one, with
+ * the byte that caused it: the decoded key, 0 if the run only took
+ * prefix or modifier codes, or the received byte. This is how long
+ * either decoder can hold up the main loop; a capture (replay.h) of
+ * the session that produced it can be replayed to check it again.
+ *
+ * With LATENCY undefined the hooks expand to nothing and latency.c is
+ * empty.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <stdint.h>
+
+#include <avr/io.h>
+#include "hal.h"
+#include "clock.h"
+
+//#define LATENCY		/* compile the histograms in, the mega profiles do */
+
+#define LAT_KEY		0
+#define LAT_DISP	1
+#define LAT_BUCKETS	12
+#define LAT_RUN_RX	1	/* lat_worst index for task_rx, LAT_KEY for task_kbd */
+
+#ifdef LATENCY
+
+extern volatile uint16_t lat_hist[2][LAT_BUCKETS];
+extern volatile uint16_t lat_frame_t;	/* end of the last PS/2 frame */
+extern volatile uint16_t lat_key_t0;
+extern volatile uint8_t lat_key_slot;	/* TX ring slot of the key being timed */
+extern volatile uint8_t lat_key_on;
+extern volatile uint16_t lat_rx_t0;
+extern volatile uint8_t lat_rx_slot;	/* RX ring slot of the byte being timed */
+extern volatile uint8_t lat_rx_on;	/* 1 queued, 2 being processed */
+extern uint16_t lat_worst[2];		/* longest task run, in ticks */
+extern uint8_t lat_worst_in[2];		/* and the byte it was for */
+extern uint16_t lat_run_t0;
+
+void lat_record(uint8_t h, uint16_t t0);
+void lat_key_mark(void);
+void lat_displayed(void);
+void lat_run_end(uint8_t h, uint8_t in);
+void lat_report(void);
+
+// In ISR(KBD_INT), when a frame is complete
+#define LAT_FRAME()		lat_frame_t = CLOCK_NOW()
+
+// Before handing a decoded key on: time the next byte queued for TX
+#define LAT_KEY_MARK()		lat_key_mark()
+
+// In the UDRE ISR, about to load ring slot s into UDR
+#define LAT_TX(s)	do { if (lat_key_on && (s) == lat_key_slot) \
+				{ lat_key_on = 0; lat_record(LAT_KEY, lat_key_t0); } } while (0)
+
+// In the RX ISR, having queued the byte in ring slot s
+#define LAT_RX(s)	do { if (!lat_rx_on) \
+				{ lat_rx_t0 = CLOCK_NOW(); lat_rx_slot = (s); lat_rx_on = 1; } } while (0)
+
+// In task_rx, around processing the byte from ring slot s. DONE drops the
+// sample if the byte left nothing to display.
+#define LAT_RX_TAKE(s)	do { if (lat_rx_on == 1 && (s) == lat_rx_slot) lat_rx_on = 2; } while (0)
+#define LAT_RX_DONE()	do { if (lat_rx_on == 2) lat_rx_on = 0; } while (0)
+
+// When the display queue has been drawn
+#define LAT_DISPLAYED()		lat_displayed()
+
+// Around a run of task_kbd (h LAT_KEY) or task_rx (h LAT_RUN_RX)
+#define LAT_RUN_START()		lat_run_t0 = clock_now()
+#define LAT_RUN_END(h, in)	lat_run_end(h, in)
+
+#else
+
+#define LAT_FRAME()
+#define LAT_KEY_MARK()
+#define LAT_TX(s)
+#define LAT_RX(s)
+#define LAT_RX_TAKE(s)
+#define LAT_RX_DONE()
+#define LAT_DISPLAYED()
+#define LAT_RUN_START()
+#define LAT_RUN_END(h, in)
+#define lat_report()
+
+#endif
+
+#endif //__LATENCY_H__
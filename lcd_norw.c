@@ -1,355 +1,784 @@
-/**************************************************************************
- *
- * LCD.C - Cut down version of Peter Fleury's LCD Library for HD44780U
- * This library takes the ET-JRAVR LCD derps into account. The R/W line
- * is pinned to ground in WRITE always mode. This means that reads from
- * the LCD are pointless. This implies, of course, that the busy bit is
- * therefore unavailable, hence the horrendously large delays
- *
- * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
- * All Rights Reserved
- *
- **************************************************************************/
-
-/****************************************************************************
- Title	:   HD44780U LCD library
- Author:    Peter Fleury <pfleury@gmx.ch>  http://jump.to/fleury
- File:	    $Id: lcd.c,v 1.13.2.2 2004/02/12 21:08:25 peter Exp $
- Software:  AVR-GCC 3.3
- Target:    any AVR device, memory mapped mode only for AT90S4414/8515/Mega
-
- DESCRIPTION
-       Basic routines for interfacing a HD44780U-based text lcd display
-
-       Originally based on Volker Oth's lcd library,
-       changed lcd_init(), added additional constants for lcd_command(),
-       added 4-bit I/O mode, improved and optimized code.
-
-       Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in
-       4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
-
-       Memory mapped mode compatible with Kanda STK200, but supports also
-       generation of R/W signal through A8 address line.
-
- USAGE
-       See the C include lcd.h file for a description of each function
-
-*****************************************************************************/
-
-// extended by Martin Thomas 3/2004, removed bugs(?), added functions
-// and maybe added new bugs
-// 6/2005 - update to be compatible with avr-libc 1.2.3, mth
-
-#include <inttypes.h>
-#include <avr/io.h>
-#include <avr/pgmspace.h>
-#include "lcd_norw.h"
-
-#include <util/delay.h>
-
-/*
-** constants/macros
-*/
-#define PIN(x) (*(&x - 2))  /* address of data direction register of port x */
-#define DDR(x) (*(&x - 1))  /* address of input register of port x          */
-
-
-//#define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
-#define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
-#define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
-#define lcd_e_toggle()  toggle_e()
-#define lcd_rw_high()   LCD_RW_PORT |=  _BV(LCD_RW_PIN)
-#define lcd_rw_low()    LCD_RW_PORT &= ~_BV(LCD_RW_PIN)
-#define lcd_rs_high()   LCD_RS_PORT |=  _BV(LCD_RS_PIN)
-#define lcd_rs_low()    LCD_RS_PORT &= ~_BV(LCD_RS_PIN)
-
-#if LCD_IO_MODE
-#if LCD_LINES==1
-#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_4BIT_1LINE
-#else
-#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_4BIT_2LINES
-#endif
-#else
-#if LCD_LINES==1
-#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_8BIT_1LINE
-#else
-#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_8BIT_2LINES
-#endif
-#endif
-
-
-/*
-** function prototypes
-*/
-static void toggle_e(void);
-
-/*
-** local functions
-*/
-
-/* toggle Enable Pin to initiate write */
-static void toggle_e(void)
-{
-    lcd_e_low();
-    _delay_ms(10);
-    lcd_e_high();
-}
-
-/*************************************************************************
-Low-level function to write byte to LCD controller
-Input:    data   byte to write to LCD
-          rs     1: write data
-                 0: write instruction
-Returns:  none
-*************************************************************************/
-static void lcd_write(uint8_t data,uint8_t rs)
-{
-    //unsigned char dataBits ;
-
-    if (rs) {   /* write data        (RS=1, RW=0) */
-       lcd_rs_high();
-    } else {    /* write instruction (RS=0, RW=0) */
-       lcd_rs_low();
-    }
-
-	/* configure data pins as output */
-	DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
-	DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
-	DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
-	DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
-
-	/* output high nibble first */
-	LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
-	LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
-	LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
-	LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
-	if(data & 0x80) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-	if(data & 0x40) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-	if(data & 0x20) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-	if(data & 0x10) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-	lcd_e_toggle();
-
-	/* output low nibble */
-	LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
-	LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
-	LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
-	LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
-	if(data & 0x08) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-	if(data & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-	if(data & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-	if(data & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-	lcd_e_toggle();
-
-	/* all data pins high (inactive) */
-	LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-	LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-	LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-	LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-
-}
-
-/*************************************************************************
-Move cursor to the start of next line or to the first line if the cursor
-is already on the last line.
-*************************************************************************/
-static inline void lcd_newline(uint8_t pos)
-{
-    register uint8_t addressCounter;
-
-
-#if LCD_LINES==1
-    addressCounter = 0;
-#endif
-#if LCD_LINES==2
-    if ( pos < (LCD_START_LINE2) )
-        addressCounter = LCD_START_LINE2;
-    else
-        addressCounter = LCD_START_LINE1;
-#endif
-#if LCD_LINES==4
-    if ( pos < LCD_START_LINE3 )
-        addressCounter = LCD_START_LINE2;
-    else if ( (pos >= LCD_START_LINE2) && (pos < LCD_START_LINE4) )
-        addressCounter = LCD_START_LINE3;
-    else if ( (pos >= LCD_START_LINE3) && (pos < LCD_START_LINE2) )
-        addressCounter = LCD_START_LINE4;
-    else {
-		// mtmt added autoscroll
-		#ifdef LCD_AUTO_SCROLL
-		lcd_scrollup();
-		_delay_ms(1);
-		addressCounter = LCD_START_LINE4;
-		#else
-	    addressCounter = LCD_START_LINE1;
-		#endif
-	}
-#endif
-    lcd_command((1<<LCD_DDRAM)+addressCounter);
-
-}/* lcd_newline */
-
-
-/*
-** PUBLIC FUNCTIONS
-*/
-
-/*************************************************************************
-Send LCD controller instruction command
-Input:   instruction to send to LCD controller, see HD44780 data sheet
-Returns: none
-*************************************************************************/
-void lcd_command(uint8_t cmd)
-{
-    lcd_write(cmd,LCD_CMD);
-}
-
-/*************************************************************************
-Set cursor to specified position
-Input:    x  horizontal position  (0: left most position)
-          y  vertical position    (0: first line)
-Returns:  none
-*************************************************************************/
-void lcd_gotoxy(uint8_t x, uint8_t y)
-{
-#if LCD_LINES==1
-    lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-#endif
-#if LCD_LINES==2
-    if ( y==0 )
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-    else
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-#endif
-#if LCD_LINES==4
-    if ( y==0 )
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-    else if ( y==1)
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-    else if ( y==2)
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE3+x);
-    else /* y==3 */
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE4+x);
-#endif
-
-}/* lcd_gotoxy */
-
-
-/*************************************************************************
-Clear display and set cursor to home position
-*************************************************************************/
-void lcd_clrscr(void)
-{
-    lcd_command(1<<LCD_CLR);
-}
-
-
-/*************************************************************************
-Set cursor to home position
-*************************************************************************/
-void lcd_home(void)
-{
-    lcd_command(1<<LCD_HOME);
-}
-
-/*************************************************************************
-Display char 
-Input:    char to be displayed
-Returns:  none
-*************************************************************************/
-void lcd_putc(const char c)
-/* print char on lcd */
-{
-    lcd_write(c,LCD_DATA);
-	
-}/* lcd_putc */
-
-/*************************************************************************
-Display string without auto linefeed
-Input:    string to be displayed
-Returns:  none
-*************************************************************************/
-void lcd_puts(const char *s)
-/* print string on lcd (no auto linefeed) */
-{
-    register char c;
-	uint8_t i = 0;
-
-    while ( (c = *s++) ) {
-        lcd_write(c,LCD_DATA);
-		i++;
-    }
-
-	
-}/* lcd_puts */
-
-
-/*************************************************************************
-Display string from program memory without auto linefeed
-Input:     string from program memory be be displayed
-Returns:   none
-*************************************************************************/
-void lcd_puts_p(const char *progmem_s)
-/* print string from program memory on lcd (no auto linefeed) */
-{
-    register char c;
-
-    while ( (c = pgm_read_byte(progmem_s++)) ) {
-        lcd_write(c,LCD_DATA);
-    }
-
-}/* lcd_puts_p */
-
-
-/*************************************************************************
-Initialize display and select type of cursor
-Input:    dispAttr LCD_DISP_OFF            display off
-                   LCD_DISP_ON             display on, cursor off
-                   LCD_DISP_ON_CURSOR      display on, cursor on
-                   LCD_DISP_CURSOR_BLINK   display on, cursor on flashing
-Returns:  none
-*************************************************************************/
-void lcd_init(uint8_t dispAttr)
-{
-    /*
-     *  Initialize LCD to 4 bit I/O mode
-     */
-
-	/* configure all port bits as output (LCD data and control lines on different ports */
-	DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
-	DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
-	DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
-	DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
-	DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
-	DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
-	DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
-
-    _delay_ms(16);        /* wait 16ms or more after power-on       */
-
-    /* initial write to lcd is 8bit */
-    LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);  // _BV(LCD_FUNCTION)>>4;
-    LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);  // _BV(LCD_FUNCTION_8BIT)>>4;
-    lcd_e_toggle();
-    _delay_ms(4);         /* delay, busy flag can't be checked here */
-
-    /* repeat last command */
-    lcd_e_toggle();
-    _delay_ms(1);           /* delay, busy flag can't be checked here */
-
-    /* repeat last command a third time */
-    lcd_e_toggle();
-    _delay_ms(1);           /* delay, busy flag can't be checked here */
-
-    /* now configure for 4bit mode */
-    LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);   // LCD_FUNCTION_4BIT_1LINE>>4
-    lcd_e_toggle();
-    _delay_ms(1);           /* some displays need this additional delay */
-
-    /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */
-
-    lcd_command(LCD_FUNCTION_DEFAULT);      /* function set: display lines  */
-    lcd_command(LCD_DISP_OFF);              /* display off                  */
-    lcd_clrscr();                           /* display clear                */
-    lcd_command(LCD_MODE_DEFAULT);          /* set entry mode               */
-    lcd_command(dispAttr);                  /* display/cursor control       */
-
-}/* lcd_init */
+/**************************************************************************
+ *
+ * LCD.C - Cut down version of Peter Fleury's LCD Library for HD44780U
+ * This library takes the ET-JRAVR LCD derps into account. The R/W line
+ * is pinned to ground in WRITE always mode. This means that reads from
+ * the LCD are pointless. This implies, of course, that the busy bit is
+ * therefore unavailable, hence the horrendously large delays
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+/****************************************************************************
+ Title	:   HD44780U LCD library
+ Author:    Peter Fleury <pfleury@gmx.ch>  http://jump.to/fleury
+ File:	    $Id: lcd.c,v 1.13.2.2 2004/02/12 21:08:25 peter Exp $
+ Software:  AVR-GCC 3.3
+ Target:    any AVR device, memory mapped mode only for AT90S4414/8515/Mega
+
+ DESCRIPTION
+       Basic routines for interfacing a HD44780U-based text lcd display
+
+       Originally based on Volker Oth's lcd library,
+       changed lcd_init(), added additional constants for lcd_command(),
+       added 4-bit I/O mode, improved and optimized code.
+
+       Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in
+       4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
+
+       Memory mapped mode compatible with Kanda STK200, but supports also
+       generation of R/W signal through A8 address line.
+
+ USAGE
+       See the C include lcd.h file for a description of each function
+
+*****************************************************************************/
+
+// extended by Martin Thomas 3/2004, removed bugs(?), added functions
+// and maybe added new bugs
+// 6/2005 - update to be compatible with avr-libc 1.2.3, mth
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "lcd_norw.h"
+#include "clock.h"
+#include "trace.h"
+
+#include <util/delay.h>
+
+/*
+** constants/macros
+*/
+#define PIN(x) (*(&x - 2))  /* address of data direction register of port x */
+#define DDR(x) (*(&x - 1))  /* address of input register of port x          */
+
+
+//#define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
+#define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
+#define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
+#define lcd_e2_high()   LCD_E2_PORT |=  _BV(LCD_E2_PIN);
+#define lcd_e2_low()    LCD_E2_PORT &= ~_BV(LCD_E2_PIN);
+#define lcd_e_toggle()  toggle_e()
+#define lcd_rw_high()   LCD_RW_PORT |=  _BV(LCD_RW_PIN)
+#define lcd_rw_low()    LCD_RW_PORT &= ~_BV(LCD_RW_PIN)
+#if LCD_SERIAL
+static uint8_t lcd_sr_rs;               /* RS bit shifted out with each nibble */
+#define lcd_rs_high()   lcd_sr_rs = _BV(LCD_SR_RS)
+#define lcd_rs_low()    lcd_sr_rs = 0
+#else
+#define lcd_rs_high()   LCD_RS_PORT |=  _BV(LCD_RS_PIN)
+#define lcd_rs_low()    LCD_RS_PORT &= ~_BV(LCD_RS_PIN)
+#endif
+
+#if LCD_IO_MODE
+#if LCD_LINES==1
+#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_4BIT_1LINE
+#else
+#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_4BIT_2LINES
+#endif
+#else
+#if LCD_LINES==1
+#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_8BIT_1LINE
+#else
+#define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_8BIT_2LINES
+#endif
+#endif
+
+
+#if LCD_CONTROLLERS > 1
+#define LCD_CTRL_LINES  (LCD_LINES/2)   /* lines per controller */
+uint8_t lcd_ctrl = 0;                   /* controller being written to */
+#if LCD_SHADOW
+uint8_t lcd_sx = 0;                     /* cursor of the other controller */
+uint8_t lcd_sy = LCD_CTRL_LINES;
+#endif
+#else
+#define lcd_ctrl 0
+#endif
+
+/* busy window of each controller: start time and length in clock ticks */
+uint16_t lcd_t0[LCD_CONTROLLERS];
+uint16_t lcd_win[LCD_CONTROLLERS];
+
+#if LCD_SHADOW
+char lcd_shadow[LCD_LINES][LCD_SHADOW_LENGTH] NOINIT;   /* kept for lcd_restore() */
+uint8_t lcd_x NOINIT;
+uint8_t lcd_y NOINIT;
+#endif
+#if LCD_SHADOW && LCD_SCROLL_FUNCTION
+uint8_t lcd_scrolling = 0;
+static uint8_t lcd_sc_x, lcd_sc_y;      /* next cell the scroll copies to */
+#if LCD_CONTROLLERS > 1
+static uint8_t lcd_sc_b;                /* 1: the second controller's cell is next */
+#endif
+
+/* start scrolling up, lcd_scroll_step() does the work */
+static void lcd_scroll_start(void)
+{
+    lcd_scrolling = 1;
+    lcd_sc_x = 0;
+    lcd_sc_y = 0;
+#if LCD_CONTROLLERS > 1
+    lcd_sc_b = 0;
+#endif
+}
+#endif
+#if LCD_HSCROLL
+uint8_t lcd_shift = 0;                 /* columns the display is shifted left by */
+#endif
+
+
+/*
+** function prototypes
+*/
+static void toggle_e(void);
+
+/*
+** local functions
+*/
+
+/* toggle Enable Pin of the current controller to initiate write */
+static void toggle_e(void)
+{
+#if LCD_CONTROLLERS > 1
+    if ( lcd_ctrl ) {
+        lcd_e2_low();
+        _delay_us(1);
+        lcd_e2_high();
+        return;
+    }
+#endif
+    lcd_e_low();
+    _delay_us(1);
+    lcd_e_high();
+}
+
+#if LCD_CONTROLLERS > 1
+/* make the controller driving line y the current one, swapping cursors */
+static void lcd_select(uint8_t y)
+{
+    uint8_t c = ( y >= LCD_CTRL_LINES );
+#if LCD_SHADOW
+    uint8_t t;
+#endif
+
+    if ( c == lcd_ctrl )
+        return;
+    lcd_ctrl = c;
+#if LCD_SHADOW
+    t = lcd_x; lcd_x = lcd_sx; lcd_sx = t;
+    t = lcd_y; lcd_y = lcd_sy; lcd_sy = t;
+#endif
+}
+
+/* send an instruction to every controller */
+static void lcd_command_all(uint8_t cmd)
+{
+    uint8_t c = lcd_ctrl;
+
+    lcd_ctrl = 0;
+    lcd_command(cmd);
+    lcd_ctrl = 1;
+    lcd_command(cmd);
+    lcd_ctrl = c;
+}
+/* toggle the Enable lines of both controllers */
+static void toggle_e_all(void)
+{
+    lcd_ctrl = 1;
+    toggle_e();
+    lcd_ctrl = 0;
+    toggle_e();
+}
+#define lcd_e_toggle_all()      toggle_e_all()
+#else
+#define lcd_command_all(cmd)    lcd_command(cmd)
+#define lcd_e_toggle_all()      toggle_e()
+#endif
+
+#if LCD_SERIAL
+/* two USICR writes per bit: USCK high (the 595 samples DO), then low and shift */
+#define SR_BIT()    do { USICR = hi; USICR = lo; } while (0)
+
+/* shift the low nibble of d and RS into the 74HC595 and latch them out */
+static void lcd_nibble(uint8_t d)
+{
+    uint8_t hi = _BV(USIWM0) | _BV(USITC);
+    uint8_t lo = _BV(USIWM0) | _BV(USITC) | _BV(USICLK);
+
+    USIDR = (d & 0x0f) | lcd_sr_rs;
+    SR_BIT(); SR_BIT(); SR_BIT(); SR_BIT();
+    SR_BIT(); SR_BIT(); SR_BIT(); SR_BIT();
+    LCD_SR_LATCH_PORT |=  _BV(LCD_SR_LATCH_PIN);
+    LCD_SR_LATCH_PORT &= ~_BV(LCD_SR_LATCH_PIN);
+}
+#else
+/* put the low nibble of d on the data lines */
+static void lcd_nibble(uint8_t d)
+{
+	LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
+	LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
+	LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
+	LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
+	if(d & 0x08) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
+	if(d & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
+	if(d & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
+	if(d & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
+}
+#endif
+
+/*************************************************************************
+Low-level function to write byte to LCD controller
+Input:    data   byte to write to LCD
+          rs     1: write data
+                 0: write instruction
+Returns:  none
+*************************************************************************/
+static void lcd_write(uint8_t data,uint8_t rs)
+{
+    //unsigned char dataBits ;
+
+    TRACE_EVENT(TR_LCD_WRITE);
+
+    /* wait for this controller only, the other one may still be busy */
+    while ( (uint16_t)(clock_now() - lcd_t0[lcd_ctrl]) < lcd_win[lcd_ctrl] )
+        ;
+
+    if (rs) {   /* write data        (RS=1, RW=0) */
+       lcd_rs_high();
+    } else {    /* write instruction (RS=0, RW=0) */
+       lcd_rs_low();
+    }
+
+#if !LCD_SERIAL
+	/* configure data pins as output */
+	DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
+	DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
+	DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
+	DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
+#endif
+
+	/* output high nibble first */
+	lcd_nibble(data >> 4);
+	lcd_e_toggle();
+
+	/* output low nibble */
+	lcd_nibble(data);
+	lcd_e_toggle();
+
+#if !LCD_SERIAL
+	/* all data pins high (inactive) */
+	LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
+	LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
+	LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
+	LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
+#endif
+
+	/* clear and home take much longer than everything else */
+	lcd_t0[lcd_ctrl] = clock_now();
+	lcd_win[lcd_ctrl] = ( !rs && data < 4 ) ? CLOCK_US(LCD_CLEAR_US) : CLOCK_US(LCD_EXEC_US);
+
+}
+
+
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*************************************************************************
+Send LCD controller instruction command
+Input:   instruction to send to LCD controller, see HD44780 data sheet
+Returns: none
+*************************************************************************/
+void lcd_command(uint8_t cmd)
+{
+    lcd_write(cmd,LCD_CMD);
+}
+
+
+/*************************************************************************
+Test whether the current controller is still busy
+Returns:  non-zero while its busy window is open
+*************************************************************************/
+uint8_t lcd_busy(void)
+{
+    return (uint16_t)(clock_now() - lcd_t0[lcd_ctrl]) < lcd_win[lcd_ctrl];
+}
+
+#if LCD_HSCROLL
+/*************************************************************************
+Shift the display one step towards showing column x
+Input:    x  column to bring into view
+Returns:  1 if a shift command was sent, 0 if x already is in view
+*************************************************************************/
+uint8_t lcd_hscroll(uint8_t x)
+{
+    if ( x < lcd_shift ) {
+        lcd_shift--;
+        lcd_command_all(LCD_MOVE_DISP_RIGHT);
+        return 1;
+    }
+    if ( x >= lcd_shift + LCD_DISP_LENGTH && lcd_shift < LCD_SHADOW_LENGTH - LCD_DISP_LENGTH ) {
+        lcd_shift++;
+        lcd_command_all(LCD_MOVE_DISP_LEFT);
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+/*************************************************************************
+Set cursor to specified position
+Input:    x  horizontal position  (0: left most position)
+          y  vertical position    (0: first line)
+Returns:  none
+*************************************************************************/
+void lcd_gotoxy(uint8_t x, uint8_t y)
+{
+#if LCD_SHADOW
+#if LCD_CONTROLLERS > 1
+    lcd_select(y);
+#endif
+    /* the address counter is already there */
+    if ( x == lcd_x && y == lcd_y )
+        return;
+#endif
+
+#if LCD_LINES==1
+    lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
+#endif
+#if LCD_LINES==2
+    if ( y==0 )
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
+    else
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
+#endif
+#if LCD_LINES==4 && LCD_CONTROLLERS > 1
+    lcd_select(y);
+    if ( (y & 1)==0 )
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
+    else
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
+#elif LCD_LINES==4
+    if ( y==0 )
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
+    else if ( y==1)
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
+    else if ( y==2)
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE3+x);
+    else /* y==3 */
+        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE4+x);
+#endif
+
+#if LCD_SHADOW
+    lcd_x = x;
+    lcd_y = y;
+#endif
+
+}/* lcd_gotoxy */
+
+
+/*************************************************************************
+Clear display and set cursor to home position
+*************************************************************************/
+void lcd_clrscr(void)
+{
+#if LCD_SHADOW
+    uint8_t i;
+
+    for (i = 0; i < sizeof(lcd_shadow); i++)
+        (&lcd_shadow[0][0])[i] = ' ';
+    lcd_x = 0;
+    lcd_y = 0;
+#if LCD_CONTROLLERS > 1
+    lcd_ctrl = 0;
+    lcd_sx = 0;
+    lcd_sy = LCD_CTRL_LINES;
+#endif
+#if LCD_SCROLL_FUNCTION
+    lcd_scrolling = 0;
+#endif
+#endif
+
+#if LCD_HSCROLL
+    lcd_shift = 0;
+#endif
+
+    lcd_command_all(1<<LCD_CLR);
+}
+
+
+/*************************************************************************
+Set cursor to home position
+*************************************************************************/
+void lcd_home(void)
+{
+#if LCD_SHADOW
+    lcd_x = 0;
+    lcd_y = 0;
+#if LCD_CONTROLLERS > 1
+    lcd_ctrl = 0;
+    lcd_sx = 0;
+    lcd_sy = LCD_CTRL_LINES;
+#endif
+#endif
+
+#if LCD_HSCROLL
+    lcd_shift = 0;
+#endif
+
+    lcd_command_all(1<<LCD_HOME);
+}
+
+/*************************************************************************
+Display char 
+Input:    char to be displayed
+Returns:  none
+*************************************************************************/
+void lcd_putc(const char c)
+/* print char on lcd */
+{
+#if LCD_SHADOW
+#if LCD_SCROLL_FUNCTION
+    while ( lcd_scroll_step() )     /* finish a scroll lcd_newline() started */
+        ;
+#endif
+    if ( lcd_x >= LCD_SHADOW_LENGTH ) {
+#if LCD_WRAP_LINES
+        lcd_newline();
+#if LCD_SCROLL_FUNCTION
+        while ( lcd_scroll_step() )
+            ;
+#endif
+#else
+        return;                     /* past the end of the line, it wouldn't show */
+#endif
+    }
+    if ( lcd_y < LCD_LINES )
+        lcd_shadow[lcd_y][lcd_x] = c;
+    lcd_x++;
+#endif
+
+    lcd_write(c,LCD_DATA);
+	
+}/* lcd_putc */
+
+
+#if LCD_SHADOW
+/*************************************************************************
+Display char at a position, skipping the write if the shadow copy says
+the character is already there, and the address command if the cursor
+already is in the right place.
+Input:    x, y  position
+          c     char to be displayed
+Returns:  none
+*************************************************************************/
+void lcd_putc_at(uint8_t x, uint8_t y, char c)
+{
+    if ( lcd_shadow[y][x] == c )
+        return;
+
+#if LCD_CONTROLLERS > 1
+    lcd_select(y);
+#endif
+
+    lcd_gotoxy(x,y);
+    lcd_putc(c);
+
+}/* lcd_putc_at */
+
+
+/*************************************************************************
+Move the cursor to the start of the next line. On the last line, scroll
+the display up (LCD_AUTO_SCROLL) or go back to the first line. A scroll
+is only started here; lcd_scroll_step() does the writes, and lcd_putc()
+finishes it first if the caller doesn't.
+Input:    none
+Returns:  none
+*************************************************************************/
+void lcd_newline(void)
+{
+    if ( lcd_y < LCD_LINES - 1 ) {
+        lcd_gotoxy(0, lcd_y + 1);
+        return;
+    }
+#if LCD_SCROLL_FUNCTION && LCD_AUTO_SCROLL
+    lcd_scroll_start();
+#else
+    lcd_gotoxy(0, 0);
+#endif
+
+}/* lcd_newline */
+
+
+#if LCD_SCROLL_FUNCTION
+/* scroll one cell: line y takes the line below it, the last line is cleared */
+static void lcd_scroll_cell(uint8_t x, uint8_t y)
+{
+    char c = ( y < LCD_LINES - 1 ) ? lcd_shadow[y + 1][x] : ' ';
+
+    lcd_scrolling = 0;              /* so lcd_putc() doesn't wait for itself */
+    lcd_putc_at(x, y, c);
+    lcd_scrolling = 1;
+}
+
+/*************************************************************************
+Do the next write of a scroll: each line takes the one below it and the
+last line is cleared, top to bottom, then the cursor goes to the start of
+the last line. Cells that don't change cost nothing. With two
+controllers, line y on the first one and line y + 1 on the second are
+written in lockstep, as in lcd_fill(). A cell is still overwritten only
+after the cell above has taken it, so the two overlap on the lines next
+to the boundary and not on the top and bottom ones.
+Input:    none
+Returns:  1 while the scroll is in progress, 0 once it is done
+*************************************************************************/
+uint8_t lcd_scroll_step(void)
+{
+    if ( !lcd_scrolling )
+        return 0;
+
+    if ( lcd_sc_y < LCD_LINES - (LCD_CONTROLLERS - 1) ) {
+#if LCD_CONTROLLERS > 1
+        if ( !lcd_sc_b ) {
+            lcd_sc_b = 1;
+            if ( lcd_sc_y < LCD_CTRL_LINES ) {
+                lcd_scroll_cell(lcd_sc_x, lcd_sc_y);
+                return 1;
+            }
+        }
+        lcd_sc_b = 0;
+        if ( lcd_sc_y + 1 >= LCD_CTRL_LINES )
+            lcd_scroll_cell(lcd_sc_x, lcd_sc_y + 1);
+#else
+        lcd_scroll_cell(lcd_sc_x, lcd_sc_y);
+#endif
+        if ( ++lcd_sc_x == LCD_SHADOW_LENGTH ) {
+            lcd_sc_x = 0;
+            lcd_sc_y++;
+        }
+    } else {
+        lcd_scrolling = 0;
+        lcd_gotoxy(0, LCD_LINES - 1);
+    }
+    return 1;
+
+}/* lcd_scroll_step */
+
+
+/*************************************************************************
+Scroll the display up by one line, waiting until it is done
+*************************************************************************/
+void lcd_scrollup(void)
+{
+    lcd_scroll_start();
+    while ( lcd_scroll_step() )
+        ;
+
+}/* lcd_scrollup */
+#endif
+
+
+/*************************************************************************
+Fill a region with a char, skipping cells that already hold it. With two
+controllers, a line and the matching line on the other controller are
+written in lockstep, so each write goes out while the other controller
+is still executing the previous one.
+Input:    x, y  top left position
+          w, h  region size
+          c     fill char
+Returns:  none
+*************************************************************************/
+void lcd_fill(uint8_t x, uint8_t y, uint8_t w, uint8_t h, char c)
+{
+    uint8_t i, j;
+#if LCD_CONTROLLERS > 1
+    uint8_t done = 0;
+#endif
+
+    for ( j = y; j < y + h; j++ ) {
+#if LCD_CONTROLLERS > 1
+        if ( done & _BV(j) )
+            continue;
+        for ( i = x; i < x + w; i++ ) {
+            lcd_putc_at(i, j, c);
+            if ( j + LCD_CTRL_LINES < y + h )
+                lcd_putc_at(i, j + LCD_CTRL_LINES, c);
+        }
+        done |= _BV(j + LCD_CTRL_LINES);
+#else
+        for ( i = x; i < x + w; i++ )
+            lcd_putc_at(i, j, c);
+#endif
+    }
+
+}/* lcd_fill */
+#endif
+
+/*************************************************************************
+Display string without auto linefeed
+Input:    string to be displayed
+Returns:  none
+*************************************************************************/
+void lcd_puts(const char *s)
+/* print string on lcd (no auto linefeed) */
+{
+    register char c;
+	uint8_t i = 0;
+
+    while ( (c = *s++) ) {
+        lcd_putc(c);
+		i++;
+    }
+
+	
+}/* lcd_puts */
+
+
+/*************************************************************************
+Display string from program memory without auto linefeed
+Input:     string from program memory be be displayed
+Returns:   none
+*************************************************************************/
+void lcd_puts_p(const char *progmem_s)
+/* print string from program memory on lcd (no auto linefeed) */
+{
+    register char c;
+
+    while ( (c = pgm_read_byte(progmem_s++)) ) {
+        lcd_putc(c);
+    }
+
+}/* lcd_puts_p */
+
+
+/*************************************************************************
+Initialize display and select type of cursor
+Input:    dispAttr LCD_DISP_OFF            display off
+                   LCD_DISP_ON             display on, cursor off
+                   LCD_DISP_ON_CURSOR      display on, cursor on
+                   LCD_DISP_CURSOR_BLINK   display on, cursor on flashing
+Returns:  none
+*************************************************************************/
+static void lcd_setup(void)
+{
+    /*
+     *  Initialize LCD to 4 bit I/O mode
+     */
+
+	/* configure all port bits as output (LCD data and control lines on different ports */
+	DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
+#if LCD_CONTROLLERS > 1
+	DDR(LCD_E2_PORT)    |= _BV(LCD_E2_PIN);
+#endif
+#if LCD_SERIAL
+	DDR(LCD_SR_PORT)    |= _BV(LCD_SR_DO_PIN) | _BV(LCD_SR_CLK_PIN);
+	DDR(LCD_SR_LATCH_PORT) |= _BV(LCD_SR_LATCH_PIN);
+	USICR = _BV(USIWM0);                    /* three-wire, clocked by software */
+#else
+	DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
+	DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
+	DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
+	DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
+	DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
+	DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
+#endif
+
+    _delay_ms(16);        /* wait 16ms or more after power-on       */
+
+    /* initial write to lcd is 8bit */
+    lcd_rs_low();
+    lcd_nibble(LCD_FUNCTION_8BIT_1LINE>>4);
+    lcd_e_toggle_all();
+    _delay_ms(4);         /* delay, busy flag can't be checked here */
+
+    /* repeat last command */
+    lcd_e_toggle_all();
+    _delay_ms(1);           /* delay, busy flag can't be checked here */
+
+    /* repeat last command a third time */
+    lcd_e_toggle_all();
+    _delay_ms(1);           /* delay, busy flag can't be checked here */
+
+    /* now configure for 4bit mode */
+    lcd_nibble(LCD_FUNCTION_4BIT_1LINE>>4);
+    lcd_e_toggle_all();
+    _delay_ms(1);           /* some displays need this additional delay */
+
+    /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */
+
+    lcd_command_all(LCD_FUNCTION_DEFAULT);  /* function set: display lines  */
+    lcd_command_all(LCD_DISP_OFF);          /* display off                  */
+
+}/* lcd_setup */
+
+
+void lcd_init(uint8_t dispAttr)
+{
+    lcd_setup();
+    lcd_clrscr();                           /* display clear                */
+    lcd_command_all(LCD_MODE_DEFAULT);      /* set entry mode               */
+    lcd_command_all(dispAttr);              /* display/cursor control       */
+
+}/* lcd_init */
+
+
+#if LCD_SHADOW
+/* draw back one cell of the shadow copy, the screen was just cleared */
+static void lcd_restore_cell(uint8_t x, uint8_t y)
+{
+    if (lcd_shadow[y][x] != ' ')
+    {
+        lcd_gotoxy(x, y);
+        lcd_putc(lcd_shadow[y][x]);
+    }
+}
+
+/*************************************************************************
+Initialize the display like lcd_init(), but keep the shadow copy and
+draw it back, cursor included. Used after a watchdog reset, when the
+shadow has survived in .noinit.
+Input:    dispAttr as for lcd_init()
+Returns:  none
+*************************************************************************/
+void lcd_restore(uint8_t dispAttr)
+{
+    uint8_t x = lcd_x;
+    uint8_t y = lcd_y;
+    uint8_t i, j;
+
+    lcd_setup();
+    lcd_home();                             /* tracking back to 0,0         */
+    lcd_command_all(1<<LCD_CLR);
+    lcd_command_all(LCD_MODE_DEFAULT);
+    lcd_command_all(dispAttr);
+#if LCD_SCROLL_FUNCTION
+    lcd_scrolling = 0;
+#endif
+
+#if LCD_CONTROLLERS > 1
+    /* a cell on each controller in turn, as in lcd_fill() */
+    for (j = 0; j < LCD_CTRL_LINES; j++)
+        for (i = 0; i < LCD_SHADOW_LENGTH; i++)
+        {
+            lcd_restore_cell(i, j);
+            lcd_restore_cell(i, j + LCD_CTRL_LINES);
+        }
+#else
+    for (j = 0; j < LCD_LINES; j++)
+        for (i = 0; i < LCD_SHADOW_LENGTH; i++)
+            lcd_restore_cell(i, j);
+#endif
+
+    if (y >= LCD_LINES)
+        y = LCD_LINES - 1;
+    if (x > LCD_SHADOW_LENGTH)
+        x = LCD_SHADOW_LENGTH;
+    lcd_gotoxy(x, y);
+
+}/* lcd_restore */
+#endif
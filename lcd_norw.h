@@ -1,275 +1,439 @@
-#ifndef __LCD_NORW_H__
-#define __LCD_NORW_H__
-/*************************************************************************
- Title	:   C include file for the HD44780U LCD library (lcd.c)
- Author:    Peter Fleury <pfleury@gmx.ch>  http://jump.to/fleury
- File:	    $Id: lcd.h,v 1.12.2.2 2004/02/12 21:05:59 peter Exp $
- Software:  AVR-GCC 3.3
- Hardware:  any AVR device, memory mapped mode only for AT90S4414/8515/Mega
-***************************************************************************/
-// extended by Martin Thomas 3/2004, removed bugs(?), added functions
-// and maybe added new bugs
-
-/****************************************************************************
- * Hacked further by the kodetroll. Removed memory mapped mode, as this mode
- * is not applicable to 2313/4313 series devices. Promoted 4-bit IO mode to
- * default. Removed reliance on R/W pin, as the Futurlec (and other) 
- * development boards are wired with the R/W pin in permanent WRITE mode. 
- * This disables the ability to read from the LCD, so functions using this
- * capability, including reading the BUSY flag are not possible. This makes
- * the display slow and prone to odd glitches, you have been warned.
- * August-September 2012 - Kodetroll
- *****************************************************************************/
-
-/**
- @defgroup pfleury_lcd LCD library
- @code #include <lcd.h> @endcode
-
- @brief Basic routines for interfacing a HD44780U-based text LCD display
-
- Originally based on Volker Oth's LCD library,
- changed lcd_init(), added additional constants for lcd_command(),
- added 4-bit I/O mode, improved and optimized code.
-
- Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in
- 4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
-
- Memory mapped mode compatible with Kanda STK200, but supports also
- generation of R/W signal through A8 address line.
-
- @author Peter Fleury pfleury@gmx.ch http://jump.to/fleury
-
- @see The chapter <a href="http://homepage.sunrise.ch/mysunrise/pfleury/avr-lcd44780.html" target="_blank">Interfacing a HD44780 Based LCD to an AVR</a>
-      on my home page.
-
-*/
-
-/*@{*/
-
-#if (__GNUC__ * 100 + __GNUC_MINOR__) < 303
-#error "This library requires AVR-GCC 3.3 or later, update to newer AVR-GCC compiler !"
-#endif
-
-#include <inttypes.h>
-#include <avr/pgmspace.h>
-
-/**
- *  @name  Definitions for MCU Clock Frequency
- *  Adapt the MCU clock frequency in Hz to your target.
- */
-//#define XTAL 4000000              /**< clock frequency in Hz, used to calculate delay timer */
-// mtmt:
-//#define XTAL 3700000              /**< clock frequency in Hz, used to calculate delay timer */
-//#define XTAL 8000000              /**< clock frequency in Hz, used to calculate delay timer */
-#define XTAL F_CPU              /**< clock frequency in Hz, used to calculate delay timer */
-
-#define LCD_CMD		0
-#define LCD_DATA	1
-
-/**
- *  @name  Definitions for Display Size
- *  Change these definitions to adapt setting to your display
- */
-//#define LCD_LINES           4     /**< number of visible lines of the display */
-//#define LCD_DISP_LENGTH    16     /**< visibles characters per line of the display */
-//#define LCD_LINE_LENGTH  0x10     /**< internal line length of the display    */
-
-#define LCD_LINES           2     /**< number of visible lines of the display */
-#define LCD_DISP_LENGTH    24     /**< visibles characters per line of the display */
-#define LCD_LINE_LENGTH  0x28     /**< internal line length of the display    */
-
-// mtmt for reichelt 16*4 Dispaytech 164A
-#define LCD_START_LINE1  0x00     /**< DDRAM address of first char of line 1 */
-#define LCD_START_LINE2  0x40     /**< DDRAM address of first char of line 2 */
-#define LCD_START_LINE3  0x10     /**< DDRAM address of first char of line 3 */
-#define LCD_START_LINE4  0x50     /**< DDRAM address of first char of line 4 */
-
-#define LCD_WRAP_LINES      1     /**< 0: no wrap, 1: wrap at end of visibile line */
-
-// mtmt Scroll and autoscroll added
-#define LCD_SCROLL_FUNCTION 1     /**< include scroll-up function */
-#define LCD_AUTO_SCROLL 1         /**< auto-scroll on fullscreen only in combination with LCD_SCROLL_FUNCTION  */
-
-#define LCD_IO_MODE      1         /**< 0: memory mapped mode, 1: IO port mode */
-
-/**
- *  @name Definitions for 4-bit IO mode
- *  Change LCD_PORT if you want to use a different port for the LCD pins.
- *
- *  The four LCD data lines and the three control lines RS, RW, E can be on the
- *  same port or on different ports.
- *  Change LCD_RS_PORT, LCD_RW_PORT, LCD_E_PORT if you want the control lines on
- *  different ports.
- *
- *  Normally the four data lines should be mapped to bit 0..3 on one port, but it
- *  is possible to connect these data lines in different order or even on different
- *  ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
- *
- */
-#define LCD_PORT         PORTB        /**< port for the LCD lines   */
-#define LCD_DATA0_PORT   LCD_PORT     /**< port for 4bit data bit 0 */
-#define LCD_DATA1_PORT   LCD_PORT     /**< port for 4bit data bit 1 */
-#define LCD_DATA2_PORT   LCD_PORT     /**< port for 4bit data bit 2 */
-#define LCD_DATA3_PORT   LCD_PORT     /**< port for 4bit data bit 3 */
-#define LCD_DATA0_PIN    4            /**< pin for 4bit data bit 0  */
-#define LCD_DATA1_PIN    5            /**< pin for 4bit data bit 1  */
-#define LCD_DATA2_PIN    6            /**< pin for 4bit data bit 2  */
-#define LCD_DATA3_PIN    7            /**< pin for 4bit data bit 3  */
-#define LCD_RS_PORT      LCD_PORT     /**< port for RS line         */
-#define LCD_RS_PIN       2            /**< pin  for RS line         */
-#define LCD_RW_PORT      LCD_PORT     /**< port for RW line         */
-#define LCD_RW_PIN       1            /**< pin  for RW line         */
-#define LCD_E_PORT       LCD_PORT     /**< port for Enable line     */
-#define LCD_E_PIN        3            /**< pin  for Enable line     */
-
-
-/**
- *  @name Definitions for LCD command instructions
- *  The constants define the various LCD controller instructions which can be passed to the
- *  function lcd_command(), see HD44780 data sheet for a complete description.
- */
-
-/* instruction register bit positions, see HD44780U data sheet */
-#define LCD_CLR               0      /* DB0: clear display                  */
-#define LCD_HOME              1      /* DB1: return to home position        */
-#define LCD_ENTRY_MODE        2      /* DB2: set entry mode                 */
-#define LCD_ENTRY_INC         1      /*   DB1: 1=increment, 0=decrement     */
-#define LCD_ENTRY_SHIFT       0      /*   DB2: 1=display shift on           */
-#define LCD_ON                3      /* DB3: turn lcd/cursor on             */
-#define LCD_ON_DISPLAY        2      /*   DB2: turn display on              */
-#define LCD_ON_CURSOR         1      /*   DB1: turn cursor on               */
-#define LCD_ON_BLINK          0      /*     DB0: blinking cursor ?          */
-#define LCD_MOVE              4      /* DB4: move cursor/display            */
-#define LCD_MOVE_DISP         3      /*   DB3: move display (0-> cursor) ?  */
-#define LCD_MOVE_RIGHT        2      /*   DB2: move right (0-> left) ?      */
-#define LCD_FUNCTION          5      /* DB5: function set                   */
-#define LCD_FUNCTION_8BIT     4      /*   DB4: set 8BIT mode (0->4BIT mode) */
-#define LCD_FUNCTION_2LINES   3      /*   DB3: two lines (0->one line)      */
-#define LCD_FUNCTION_10DOTS   2      /*   DB2: 5x10 font (0->5x7 font)      */
-#define LCD_CGRAM             6      /* DB6: set CG RAM address             */
-#define LCD_DDRAM             7      /* DB7: set DD RAM address             */
-#define LCD_BUSY              7      /* DB7: LCD is busy                    */
-
-/* set entry mode: display shift on/off, dec/inc cursor move direction */
-#define LCD_ENTRY_DEC            0x04   /* display shift off, dec cursor move dir */
-#define LCD_ENTRY_DEC_SHIFT      0x05   /* display shift on,  dec cursor move dir */
-#define LCD_ENTRY_INC_           0x06   /* display shift off, inc cursor move dir */
-#define LCD_ENTRY_INC_SHIFT      0x07   /* display shift on,  inc cursor move dir */
-
-/* display on/off, cursor on/off, blinking char at cursor position */
-#define LCD_DISP_OFF             0x08   /* display off                            */
-#define LCD_DISP_ON              0x0C   /* display on, cursor off                 */
-#define LCD_DISP_ON_BLINK        0x0D   /* display on, cursor off, blink char     */
-#define LCD_DISP_ON_CURSOR       0x0E   /* display on, cursor on                  */
-#define LCD_DISP_ON_CURSOR_BLINK 0x0F   /* display on, cursor on, blink char      */
-
-/* move cursor/shift display */
-#define LCD_MOVE_CURSOR_LEFT     0x10   /* move cursor left  (decrement)          */
-#define LCD_MOVE_CURSOR_RIGHT    0x14   /* move cursor right (increment)          */
-#define LCD_MOVE_DISP_LEFT       0x18   /* shift display left                     */
-#define LCD_MOVE_DISP_RIGHT      0x1C   /* shift display right                    */
-
-/* function set: set interface data length and number of display lines */
-#define LCD_FUNCTION_4BIT_1LINE  0x20   /* 4-bit interface, single line, 5x7 dots */
-#define LCD_FUNCTION_4BIT_2LINES 0x28   /* 4-bit interface, dual line,   5x7 dots */
-#define LCD_FUNCTION_8BIT_1LINE  0x30   /* 8-bit interface, single line, 5x7 dots */
-#define LCD_FUNCTION_8BIT_2LINES 0x38   /* 8-bit interface, dual line,   5x7 dots */
-
-
-#define LCD_MODE_DEFAULT     ((1<<LCD_ENTRY_MODE) | (1<<LCD_ENTRY_INC) )
-
-/**
- *  @name Functions
- */
-
-
-/**
- @brief    Initialize display and select type of cursor
- @param    dispAttr \b LCD_DISP_OFF display off\n
-                    \b LCD_DISP_ON display on, cursor off\n
-                    \b LCD_DISP_ON_CURSOR display on, cursor on\n
-                    \b LCD_DISP_ON_CURSOR_BLINK display on, cursor on flashing
- @return  none
-*/
-extern void lcd_init(uint8_t dispAttr);
-
-
-/**
- @brief    Clear display and set cursor to home position
- @param    void
- @return   none
-*/
-extern void lcd_clrscr(void);
-
-
-/**
- @brief    Set cursor to home position
- @param    void
- @return   none
-*/
-extern void lcd_home(void);
-
-
-/**
- @brief    Set cursor to specified position
-
- @param    x horizontal position\n (0: left most position)
- @param    y vertical position\n   (0: first line)
- @return   none
-*/
-extern void lcd_gotoxy(uint8_t x, uint8_t y);
-
-
-/**
- @brief    Display character at current cursor position
- @param    c character to be displayed
- @return   none
-*/
-extern void lcd_putc(char c);
-
-
-/**
- @brief    Display string without auto linefeed
- @param    s string to be displayed
- @return   none
-*/
-extern void lcd_puts(const char *s);
-
-
-/**
- @brief    Display string from program memory without auto linefeed
- @param    s string from program memory be be displayed
- @return   none
- @see      lcd_puts_P
-*/
-extern void lcd_puts_p(const char *progmem_s);
-
-
-/**
- @brief    Send LCD controller instruction command
- @param    cmd instruction to send to LCD controller, see HD44780 data sheet
- @return   none
-*/
-extern void lcd_command(uint8_t cmd);
-
-// mtmt new function:
-#ifdef LCD_SCROLL_FUNCTION
-/**
- @brief    Scroll LCD up
- @param    none
- @return   none
-*/
-extern void lcd_scrollup(void);
-#endif
-
-// mtmt exported for debugging
-extern uint8_t lcd_waitbusy(void);
-
-/**
- @brief macros for automatically storing string constant in program memory
-*/
-#define lcd_puts_P(__s)         lcd_puts_p(PSTR(__s))
-
-
-/*@}*/
-#endif // __LCD_NORW_H__
+#ifndef __LCD_NORW_H__
+#define __LCD_NORW_H__
+/*************************************************************************
+ Title	:   C include file for the HD44780U LCD library (lcd.c)
+ Author:    Peter Fleury <pfleury@gmx.ch>  http://jump.to/fleury
+ File:	    $Id: lcd.h,v 1.12.2.2 2004/02/12 21:05:59 peter Exp $
+ Software:  AVR-GCC 3.3
+ Hardware:  any AVR device, memory mapped mode only for AT90S4414/8515/Mega
+***************************************************************************/
+// extended by Martin Thomas 3/2004, removed bugs(?), added functions
+// and maybe added new bugs
+
+/****************************************************************************
+ * Hacked further by the kodetroll. Removed memory mapped mode, as this mode
+ * is not applicable to 2313/4313 series devices. Promoted 4-bit IO mode to
+ * default. Removed reliance on R/W pin, as the Futurlec (and other) 
+ * development boards are wired with the R/W pin in permanent WRITE mode. 
+ * This disables the ability to read from the LCD, so functions using this
+ * capability, including reading the BUSY flag are not possible. This makes
+ * the display slow and prone to odd glitches, you have been warned.
+ * August-September 2012 - Kodetroll
+ *****************************************************************************/
+
+/**
+ @defgroup pfleury_lcd LCD library
+ @code #include <lcd.h> @endcode
+
+ @brief Basic routines for interfacing a HD44780U-based text LCD display
+
+ Originally based on Volker Oth's LCD library,
+ changed lcd_init(), added additional constants for lcd_command(),
+ added 4-bit I/O mode, improved and optimized code.
+
+ Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in
+ 4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
+
+ Memory mapped mode compatible with Kanda STK200, but supports also
+ generation of R/W signal through A8 address line.
+
+ @author Peter Fleury pfleury@gmx.ch http://jump.to/fleury
+
+ @see The chapter <a href="http://homepage.sunrise.ch/mysunrise/pfleury/avr-lcd44780.html" target="_blank">Interfacing a HD44780 Based LCD to an AVR</a>
+      on my home page.
+
+*/
+
+/*@{*/
+
+#if (__GNUC__ * 100 + __GNUC_MINOR__) < 303
+#error "This library requires AVR-GCC 3.3 or later, update to newer AVR-GCC compiler !"
+#endif
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#include "hal.h"
+
+/**
+ *  @name  Definitions for MCU Clock Frequency
+ *  Adapt the MCU clock frequency in Hz to your target.
+ */
+//#define XTAL 4000000              /**< clock frequency in Hz, used to calculate delay timer */
+// mtmt:
+//#define XTAL 3700000              /**< clock frequency in Hz, used to calculate delay timer */
+//#define XTAL 8000000              /**< clock frequency in Hz, used to calculate delay timer */
+#define XTAL F_CPU              /**< clock frequency in Hz, used to calculate delay timer */
+
+#define LCD_CMD		0
+#define LCD_DATA	1
+
+/**
+ *  @name  Definitions for Display Size
+ *  Change these definitions to adapt setting to your display
+ */
+//#define LCD_LINES           4     /**< number of visible lines of the display */
+//#define LCD_DISP_LENGTH    16     /**< visibles characters per line of the display */
+//#define LCD_LINE_LENGTH  0x10     /**< internal line length of the display    */
+
+#define LCD_LINES           2     /**< number of visible lines of the display */
+#define LCD_DISP_LENGTH    24     /**< visibles characters per line of the display */
+#define LCD_LINE_LENGTH  0x28     /**< internal line length of the display    */
+
+// 40x4 modules are two 40x2 controllers sharing the bus, each with its own
+// E line. Lines 1-2 are on the first one, lines 3-4 on the second.
+//#define LCD_CONTROLLERS     2     /**< number of HD44780 controllers, 1 or 2 */
+//#define LCD_LINES           4
+//#define LCD_DISP_LENGTH    40
+//#define LCD_LINE_LENGTH  0x28
+#define LCD_CONTROLLERS     1     /**< number of HD44780 controllers, 1 or 2 */
+
+/**
+ *  @name  Instruction timing
+ *  Without RW the busy flag can't be polled, so each controller is assumed
+ *  busy for this long after every write (datasheet: 37 us, 1.52 ms for
+ *  clear/home, at 270 kHz; slow clones need more).
+ */
+#define LCD_EXEC_US        80     /**< execution time of most instructions */
+#define LCD_CLEAR_US     3000     /**< execution time of clear and home     */
+
+// mtmt for reichelt 16*4 Dispaytech 164A
+#define LCD_START_LINE1  0x00     /**< DDRAM address of first char of line 1 */
+#define LCD_START_LINE2  0x40     /**< DDRAM address of first char of line 2 */
+#define LCD_START_LINE3  0x10     /**< DDRAM address of first char of line 3 */
+#define LCD_START_LINE4  0x50     /**< DDRAM address of first char of line 4 */
+
+#define LCD_WRAP_LINES      1     /**< 0: drop chars past the end of a line, 1: wrap to the next line */
+
+// mtmt Scroll and autoscroll added
+#define LCD_SCROLL_FUNCTION 1     /**< include scroll-up function */
+#define LCD_AUTO_SCROLL 1         /**< auto-scroll on fullscreen only in combination with LCD_SCROLL_FUNCTION  */
+
+#define LCD_IO_MODE      1         /**< 0: memory mapped mode, 1: IO port mode */
+
+// The data lines and RS can come from a 74HC595 instead, fed by the USI in
+// three-wire mode, which frees three pins. See LCD_SR_* below for the wiring.
+#ifndef LCD_SERIAL
+#define LCD_SERIAL       0         /**< 1: D4-D7 and RS through a 74HC595 on the USI */
+#endif
+
+#define LCD_SHADOW       1         /**< 1: keep a RAM copy of the visible characters and the cursor */
+
+// Lines can be as long as the controller's DDRAM line, LCD_LINE_LENGTH. The
+// display shift brings the part around the cursor into view, see lcd_hscroll().
+// The cursor is only known with LCD_SHADOW.
+#define LCD_HSCROLL      1         /**< 1: lines longer than the display, shifted into view */
+
+#if LCD_HSCROLL && LCD_SHADOW && LCD_DISP_LENGTH < LCD_LINE_LENGTH
+#define LCD_SHADOW_LENGTH LCD_LINE_LENGTH   /**< columns kept in lcd_shadow */
+#else
+#undef LCD_HSCROLL
+#define LCD_HSCROLL      0
+#define LCD_SHADOW_LENGTH LCD_DISP_LENGTH
+#endif
+
+/**
+ *  @name Definitions for 4-bit IO mode
+ *  Change LCD_PORT if you want to use a different port for the LCD pins.
+ *
+ *  The four LCD data lines and the three control lines RS, RW, E can be on the
+ *  same port or on different ports.
+ *  Change LCD_RS_PORT, LCD_RW_PORT, LCD_E_PORT if you want the control lines on
+ *  different ports.
+ *
+ *  Normally the four data lines should be mapped to bit 0..3 on one port, but it
+ *  is possible to connect these data lines in different order or even on different
+ *  ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
+ *
+ */
+#ifndef LCD_PORT                      /* board profiles may move the LCD, see hal.h */
+#define LCD_PORT         PORTB        /**< port for the LCD lines   */
+#define LCD_DATA0_PORT   LCD_PORT     /**< port for 4bit data bit 0 */
+#define LCD_DATA1_PORT   LCD_PORT     /**< port for 4bit data bit 1 */
+#define LCD_DATA2_PORT   LCD_PORT     /**< port for 4bit data bit 2 */
+#define LCD_DATA3_PORT   LCD_PORT     /**< port for 4bit data bit 3 */
+#define LCD_DATA0_PIN    4            /**< pin for 4bit data bit 0  */
+#define LCD_DATA1_PIN    5            /**< pin for 4bit data bit 1  */
+#define LCD_DATA2_PIN    6            /**< pin for 4bit data bit 2  */
+#define LCD_DATA3_PIN    7            /**< pin for 4bit data bit 3  */
+#define LCD_RS_PORT      LCD_PORT     /**< port for RS line         */
+#define LCD_RS_PIN       2            /**< pin  for RS line         */
+#define LCD_RW_PORT      LCD_PORT     /**< port for RW line         */
+#define LCD_RW_PIN       1            /**< pin  for RW line         */
+#define LCD_E_PORT       LCD_PORT     /**< port for Enable line     */
+#define LCD_E_PIN        3            /**< pin  for Enable line     */
+#define LCD_E2_PORT      PORTD        /**< port for second Enable line (LCD_CONTROLLERS 2) */
+#define LCD_E2_PIN       5            /**< pin  for second Enable line */
+#endif
+
+/**
+ *  @name Definitions for the 74HC595 (LCD_SERIAL 1)
+ *  USI DO (PB6) goes to SER and USCK (PB7) to SRCLK, LCD_SR_LATCH to RCLK.
+ *  Q0-Q3 drive D4-D7 and Q4 drives RS. E and E2 stay on their own pins, RW
+ *  is tied low. The LCD_DATAx and LCD_RS definitions above are not used.
+ */
+#if LCD_SERIAL
+#ifndef HAL_USI_OVF_vect
+#error "LCD_SERIAL needs a part with a USI"
+#endif
+#ifdef KBD_USI
+#error "LCD_SERIAL and KBD_USI both need the USI"
+#endif
+#define LCD_SR_PORT       PORTB       /**< port of the USI pins         */
+#define LCD_SR_DO_PIN     6           /**< USI DO, to SER               */
+#define LCD_SR_CLK_PIN    7           /**< USI USCK, to SRCLK           */
+#define LCD_SR_LATCH_PORT PORTB       /**< port for RCLK                */
+#define LCD_SR_LATCH_PIN  4           /**< pin  for RCLK                */
+#define LCD_SR_RS         4           /**< 74HC595 output driving RS    */
+#endif
+
+
+/**
+ *  @name Definitions for LCD command instructions
+ *  The constants define the various LCD controller instructions which can be passed to the
+ *  function lcd_command(), see HD44780 data sheet for a complete description.
+ */
+
+/* instruction register bit positions, see HD44780U data sheet */
+#define LCD_CLR               0      /* DB0: clear display                  */
+#define LCD_HOME              1      /* DB1: return to home position        */
+#define LCD_ENTRY_MODE        2      /* DB2: set entry mode                 */
+#define LCD_ENTRY_INC         1      /*   DB1: 1=increment, 0=decrement     */
+#define LCD_ENTRY_SHIFT       0      /*   DB2: 1=display shift on           */
+#define LCD_ON                3      /* DB3: turn lcd/cursor on             */
+#define LCD_ON_DISPLAY        2      /*   DB2: turn display on              */
+#define LCD_ON_CURSOR         1      /*   DB1: turn cursor on               */
+#define LCD_ON_BLINK          0      /*     DB0: blinking cursor ?          */
+#define LCD_MOVE              4      /* DB4: move cursor/display            */
+#define LCD_MOVE_DISP         3      /*   DB3: move display (0-> cursor) ?  */
+#define LCD_MOVE_RIGHT        2      /*   DB2: move right (0-> left) ?      */
+#define LCD_FUNCTION          5      /* DB5: function set                   */
+#define LCD_FUNCTION_8BIT     4      /*   DB4: set 8BIT mode (0->4BIT mode) */
+#define LCD_FUNCTION_2LINES   3      /*   DB3: two lines (0->one line)      */
+#define LCD_FUNCTION_10DOTS   2      /*   DB2: 5x10 font (0->5x7 font)      */
+#define LCD_CGRAM             6      /* DB6: set CG RAM address             */
+#define LCD_DDRAM             7      /* DB7: set DD RAM address             */
+#define LCD_BUSY              7      /* DB7: LCD is busy                    */
+
+/* set entry mode: display shift on/off, dec/inc cursor move direction */
+#define LCD_ENTRY_DEC            0x04   /* display shift off, dec cursor move dir */
+#define LCD_ENTRY_DEC_SHIFT      0x05   /* display shift on,  dec cursor move dir */
+#define LCD_ENTRY_INC_           0x06   /* display shift off, inc cursor move dir */
+#define LCD_ENTRY_INC_SHIFT      0x07   /* display shift on,  inc cursor move dir */
+
+/* display on/off, cursor on/off, blinking char at cursor position */
+#define LCD_DISP_OFF             0x08   /* display off                            */
+#define LCD_DISP_ON              0x0C   /* display on, cursor off                 */
+#define LCD_DISP_ON_BLINK        0x0D   /* display on, cursor off, blink char     */
+#define LCD_DISP_ON_CURSOR       0x0E   /* display on, cursor on                  */
+#define LCD_DISP_ON_CURSOR_BLINK 0x0F   /* display on, cursor on, blink char      */
+
+/* move cursor/shift display */
+#define LCD_MOVE_CURSOR_LEFT     0x10   /* move cursor left  (decrement)          */
+#define LCD_MOVE_CURSOR_RIGHT    0x14   /* move cursor right (increment)          */
+#define LCD_MOVE_DISP_LEFT       0x18   /* shift display left                     */
+#define LCD_MOVE_DISP_RIGHT      0x1C   /* shift display right                    */
+
+/* function set: set interface data length and number of display lines */
+#define LCD_FUNCTION_4BIT_1LINE  0x20   /* 4-bit interface, single line, 5x7 dots */
+#define LCD_FUNCTION_4BIT_2LINES 0x28   /* 4-bit interface, dual line,   5x7 dots */
+#define LCD_FUNCTION_8BIT_1LINE  0x30   /* 8-bit interface, single line, 5x7 dots */
+#define LCD_FUNCTION_8BIT_2LINES 0x38   /* 8-bit interface, dual line,   5x7 dots */
+
+
+#define LCD_MODE_DEFAULT     ((1<<LCD_ENTRY_MODE) | (1<<LCD_ENTRY_INC) )
+
+/**
+ *  @name Functions
+ */
+
+
+/**
+ @brief    Initialize display and select type of cursor.
+           The Timer1 time base (clock_init()) must already be running.
+ @param    dispAttr \b LCD_DISP_OFF display off\n
+                    \b LCD_DISP_ON display on, cursor off\n
+                    \b LCD_DISP_ON_CURSOR display on, cursor on\n
+                    \b LCD_DISP_ON_CURSOR_BLINK display on, cursor on flashing
+ @return  none
+*/
+extern void lcd_init(uint8_t dispAttr);
+
+#if LCD_SHADOW
+/**
+ @brief    Initialize the display and draw the shadow copy back onto it,
+           for a restart after a watchdog reset (see wdog.h)
+ @param    dispAttr as for lcd_init()
+ @return  none
+*/
+extern void lcd_restore(uint8_t dispAttr);
+#endif
+
+
+/**
+ @brief    Clear display and set cursor to home position
+ @param    void
+ @return   none
+*/
+extern void lcd_clrscr(void);
+
+
+/**
+ @brief    Set cursor to home position
+ @param    void
+ @return   none
+*/
+extern void lcd_home(void);
+
+
+/**
+ @brief    Set cursor to specified position
+
+ @param    x horizontal position\n (0: left most position)
+ @param    y vertical position\n   (0: first line)
+ @return   none
+*/
+extern void lcd_gotoxy(uint8_t x, uint8_t y);
+
+
+/**
+ @brief    Display character at current cursor position
+ @param    c character to be displayed
+ @return   none
+*/
+extern void lcd_putc(char c);
+
+
+/**
+ @brief    Display string without auto linefeed
+ @param    s string to be displayed
+ @return   none
+*/
+extern void lcd_puts(const char *s);
+
+
+/**
+ @brief    Display string from program memory without auto linefeed
+ @param    s string from program memory be be displayed
+ @return   none
+ @see      lcd_puts_P
+*/
+extern void lcd_puts_p(const char *progmem_s);
+
+
+/**
+ @brief    Send LCD controller instruction command
+ @param    cmd instruction to send to LCD controller, see HD44780 data sheet
+ @return   none
+*/
+extern void lcd_command(uint8_t cmd);
+
+
+// mtmt exported for debugging
+extern uint8_t lcd_waitbusy(void);
+
+#if LCD_SHADOW
+/**
+ @brief    RAM copy of the visible display and the cursor position.
+           Without RW the controller can't be read back, so this is the only
+           record of what is on screen. Kept up to date by lcd_putc(),
+           lcd_gotoxy(), lcd_clrscr() and lcd_home(), not by raw lcd_command().
+*/
+extern char lcd_shadow[LCD_LINES][LCD_SHADOW_LENGTH];
+extern uint8_t lcd_x;
+extern uint8_t lcd_y;
+
+/**
+ @brief    Fill a region with a character, skipping cells that already hold it.
+           With two controllers, lines on different controllers are written
+           in lockstep so one executes while the other is being written.
+ @param    x, y  top left position
+ @param    w, h  width and height of the region
+ @param    c     fill character
+ @return   none
+*/
+extern void lcd_fill(uint8_t x, uint8_t y, uint8_t w, uint8_t h, char c);
+
+/**
+ @brief    Display character at the given position, unless it is already there
+ @param    x horizontal position\n (0: left most position)
+ @param    y vertical position\n   (0: first line)
+ @param    c character to be displayed
+ @return   none
+*/
+extern void lcd_putc_at(uint8_t x, uint8_t y, char c);
+
+/**
+ @brief    Move the cursor to the start of the next line
+ 
+ On the last line the display scrolls up (LCD_AUTO_SCROLL) or the cursor
+ goes back to the first line. lcd_putc() calls this itself when a line is
+ full and LCD_WRAP_LINES is set; without it, characters past the end of a
+ line are dropped.
+ @param    void
+ @return   none
+*/
+extern void lcd_newline(void);
+
+// mtmt new function:
+#if LCD_SCROLL_FUNCTION
+/**
+ @brief    Scroll LCD up, clearing the last line and moving the cursor to
+           its start
+ @param    none
+ @return   none
+*/
+extern void lcd_scrollup(void);
+
+/**
+ @brief    Do one write of a scroll started by lcd_newline()
+ 
+ A scroll is one write per changed cell. Callers with other work can call
+ this once per turn until it returns 0; lcd_putc() otherwise finishes the
+ scroll before writing.
+ @param    void
+ @return   1 while the scroll is in progress, 0 once done
+*/
+extern uint8_t lcd_scroll_step(void);
+extern uint8_t lcd_scrolling;
+#endif
+#endif
+
+#if !(LCD_SHADOW && LCD_SCROLL_FUNCTION)
+/* without the shadow copy there is no stepped scroll to wait for */
+#define lcd_scroll_step()	0
+#define lcd_scrolling		0
+#endif
+
+/**
+ @brief    Test whether the LCD is still executing the last instruction
+ 
+ Writing while it is busy makes the next call wait, so a caller with
+ other work to do can check this first.
+ @param    void
+ @return   non-zero while busy
+*/
+extern uint8_t lcd_busy(void);
+
+#if LCD_HSCROLL
+/**
+ @brief    Shift the display one step towards showing column x
+ 
+ One shift command moves every line by one column, instead of rewriting
+ the visible characters. Call again until it returns 0; clear and home
+ undo the shift.
+ @param    x column to bring into view
+ @return   1 if a shift command was sent, 0 if x already is in view
+*/
+extern uint8_t lcd_hscroll(uint8_t x);
+extern uint8_t lcd_shift;
+#endif
+
+/**
+ @brief macros for automatically storing string constant in program memory
+*/
+#define lcd_puts_P(__s)         lcd_puts_p(PSTR(__s))
+
+
+/*@}*/
+#endif // __LCD_NORW_H__
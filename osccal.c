@@ -0,0 +1,233 @@
+/**************************************************************************
+ *
+ * OSCCAL.C - Internal RC oscillator calibration from the serial line
+ * See osccal.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include "osccal.h"
+#include "clock.h"
+#include "uart.h"
+#include "ascii.h"
+#include "ps2_term.h"
+
+#ifdef OSC_CAL
+
+uint8_t EEMEM cal_osccal_ee = 0xFF;	// 0xFF: never calibrated
+
+// Moves OSCCAL one step at a time, big jumps can upset the CPU. Both ends
+// must be in the same HAL_OSCCAL_RANGE, across ranges the clock jumps.
+static void cal_set(uint8_t c)
+{
+	while (OSCCAL != c)
+	{
+		if (OSCCAL < c)
+			OSCCAL++;
+		else
+			OSCCAL--;
+	}
+}
+
+// Loads the stored OSCCAL, before anything is timed. A value from the other
+// range than the factory one isn't stepped to.
+void cal_init(void)
+{
+	uint8_t c = eeprom_read_byte(&cal_osccal_ee);
+
+	if (c != 0xFF && !((c ^ OSCCAL) & ~HAL_OSCCAL_RANGE))
+		cal_set(c);
+}
+
+// Waits for RXD to read level, returns 0 once lim ticks have passed since t0
+static uint8_t cal_wait(uint8_t level, uint16_t t0, uint16_t lim)
+{
+	while (!(HAL_RXD_PIN & _BV(HAL_RXD_BIT)) != !level)
+		if ((uint16_t)(CLOCK_NOW() - t0) > lim)
+			return 0;
+	return 1;
+}
+
+// Times four falling edges of the sync bytes, 8 bit times, in Timer1 ticks.
+// 0x55 with its start and stop bits is a square wave, so any falling edge
+// will do, and a run of edges spanning a gap the host left between bytes
+// fails the spacing check. The line is read directly, nothing has to come
+// through the USART. Interrupts are off for at most lim ticks. Returns 0 if
+// nothing came or the edges weren't evenly spaced.
+static uint16_t cal_byte(uint16_t lim)
+{
+	uint16_t t[5];
+	uint16_t t0 = clock_now();
+	uint16_t s, d;
+	uint8_t sreg, i;
+
+	// Interrupts on until the host is sending
+	while (HAL_RXD_PIN & _BV(HAL_RXD_BIT))
+		if ((uint16_t)(clock_now() - t0) > CLOCK_US(CAL_WAIT_US))
+			return 0;
+
+	// Then from a high level, so the first edge is seen as late as the others
+	sreg = SREG;
+	cli();
+	t0 = CLOCK_NOW();
+	i = 0;
+	if (cal_wait(1, t0, lim) && cal_wait(0, t0, lim))
+	{
+		t[0] = CLOCK_NOW();
+		for (i = 1; i < 5; i++)
+		{
+			if (!cal_wait(1, t0, lim) || !cal_wait(0, t0, lim))
+				break;
+			t[i] = CLOCK_NOW();
+		}
+	}
+	SREG = sreg;
+	if (i < 5)
+		return 0;
+
+	// Each two bit gap within a quarter of the average, polling jitter included
+	s = t[4] - t[0];
+	for (i = 1; i < 5; i++)
+	{
+		d = 4 * (t[i] - t[i - 1]);
+		if (d > s + s / 4 || d < s - s / 4)
+			return 0;
+	}
+	return s;
+}
+
+// Times CAL_BYTES sync bytes, returns the total or 0 if they stopped coming
+static uint32_t cal_sum(uint16_t lim)
+{
+	uint32_t sum = 0;
+	uint16_t s;
+	uint8_t n = 0, tries;
+
+	for (tries = 2 * CAL_BYTES; n < CAL_BYTES; tries--)
+	{
+		wdt_reset();
+		if (!tries)
+			return 0;
+		if ((s = cal_byte(lim)))
+		{
+			sum += s;
+			n++;
+		}
+	}
+	return sum;
+}
+
+// Timer1 ticks in n bit times at the USART divisor, that is at BAUD once
+// the clock is right
+static uint32_t cal_bits(uint16_t n)
+{
+	uint16_t ubrr = ((uint16_t)HAL_UBRRH << 8) | HAL_UBRRL;
+
+	return (uint32_t)n * 16 * (ubrr + 1) / CLOCK_PRESCALE;
+}
+
+// How long interrupts may stay off per sync byte
+static uint16_t cal_lim(void)
+{
+	uint32_t lim = cal_bits(CAL_CLI_BITS);
+
+	return lim < 0xFFFF ? lim : 0xFFFF;
+}
+
+// Waits until RXD has been high for CAL_IDLE_MS, the host stops sending
+// sync bytes once it has seen the reply
+static void cal_quiet(void)
+{
+	uint16_t t0 = clock_now();
+
+	while ((uint16_t)(clock_now() - t0) <= CLOCK_US(CAL_IDLE_MS * 1000UL))
+	{
+		wdt_reset();
+		if (!(HAL_RXD_PIN & _BV(HAL_RXD_BIT)))
+			t0 = clock_now();
+	}
+}
+
+// Tunes OSCCAL to the sync bytes the host is sending and replies with the
+// result. The receiver is off meanwhile, until the line has gone quiet, so
+// the sync bytes don't end up in the RX ring. Runs until done, kicking the
+// watchdog.
+void cal_run(void)
+{
+	uint32_t target = cal_bits(CAL_BYTES * 8);
+	uint16_t lim = cal_lim();
+	uint32_t sum, err;
+	uint8_t lo = OSCCAL & ~HAL_OSCCAL_RANGE, hi = lo | HAL_OSCCAL_RANGE;
+	uint8_t e = 0xFF, best = 0xFF, best_cal = OSCCAL;
+	uint8_t step = CAL_STEP, fast, last = 0, round;
+	int16_t c;
+
+	HAL_UCSRB &= ~_BV(HAL_RXEN);
+
+	for (round = 0; round < CAL_ROUNDS; round++)
+	{
+		if (!(sum = cal_sum(lim)))
+			break;
+
+		// Tenths of a percent off, a fast clock counts more ticks per bit
+		fast = sum > target;
+		err = fast ? sum - target : target - sum;
+		err = err * 1000 / target;
+		e = err < 0xFE ? err : 0xFE;
+		if (e < best)
+		{
+			best = e;
+			best_cal = OSCCAL;
+		}
+		if (e <= CAL_GOOD)
+			break;
+
+		if (round && fast != last && step > 1)
+			step >>= 1;
+		last = fast;
+
+		c = fast ? (int16_t)OSCCAL - step : (int16_t)OSCCAL + step;
+		if (c < lo)
+			c = lo;
+		if (c > hi)
+			c = hi;
+		cal_set(c);
+	}
+
+	cal_set(best_cal);
+	if (best <= CAL_SAVE)
+		eeprom_update_byte(&cal_osccal_ee, best_cal);
+
+	UART_putc('C');
+	UART_putc(' ');
+	UART_puthex(OSCCAL);
+	UART_putc(' ');
+	UART_puthex(best);
+	UART_putc(CR);
+	UART_putc(LF);
+
+	cal_quiet();
+	HAL_UCSRB |= _BV(HAL_RXEN);
+}
+
+// Runs the calibration at a cold start if the host is already sending sync
+// bytes. They are timed on the pin, so this works even when the clock is too
+// far off for the USART to take ESC U. Returns 1 if it ran, the RX ring may
+// then hold what the USART made of the sync bytes.
+uint8_t cal_boot(void)
+{
+	if (!cal_byte(cal_lim()))
+		return 0;
+
+	cal_run();
+	return 1;
+}
+
+#endif
@@ -0,0 +1,69 @@
+/**************************************************************************
+ *
+ * OSCCAL.H - Internal RC oscillator calibration from the serial line
+ * The internal oscillator is only trimmed to a few percent at the
+ * factory and drifts with temperature and supply, and the UBRR divisors
+ * round as well (see the table in uart.h), so the higher baud rates may
+ * not work without a crystal. The host can tune OSCCAL instead by
+ * sending 0x55 bytes, whose falling edges are two bits apart, until the
+ * reply comes. The edges are timed on the RXD pin with Timer1, with the
+ * USART receiver off, and OSCCAL moved until a bit is 16 * (UBRR + 1) CPU
+ * cycles at the BAUD divisor, which is what the USART expects, rounding
+ * included. The clock then isn't exactly F_CPU any more, which the
+ * millisecond tick and the LCD timing don't mind.
+ *
+ * Nothing has to get through the USART for this, so it works from a
+ * clock the USART can't receive with, as far as the OSCCAL range goes:
+ * keep sending 0x55 while the terminal is powered up or reset, and it
+ * calibrates before the sign-on (a cold start waits up to CAL_WAIT_US
+ * for them). Once the link works, ESC U followed by 0x55 bytes does the
+ * same at any time, to follow drift or when ESC 0 shows framing errors.
+ * On the megas OSCCAL is only tuned within the range, 0x00-0x7F or
+ * 0x80-0xFF, the factory value is in.
+ *
+ * The result is stored in EEPROM and loaded at reset. The reply is
+ *
+ *   C oo ee
+ *
+ *   oo  OSCCAL now
+ *   ee  bit time error left, in tenths of a percent, FF if no sync
+ *       bytes came; only results within CAL_SAVE are stored
+ *
+ * Stop sending once the reply is in, the receiver goes back on when the
+ * line has been quiet for CAL_IDLE_MS. Interrupts are off while the
+ * edges of a sync byte are timed, at most CAL_CLI_BITS bit times, so a
+ * PS/2 frame may be lost and resent during calibration.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __OSCCAL_H__
+#define __OSCCAL_H__
+
+#include <stdint.h>
+
+#include "hal.h"
+
+//#define OSC_CAL		/* boards running on the internal oscillator */
+
+#define CAL_SYNC	0x55	/* what the host sends to be timed */
+#define CAL_BYTES	16	/* sync bytes timed per OSCCAL setting */
+#define CAL_ROUNDS	16	/* OSCCAL settings tried */
+#define CAL_STEP	8	/* first OSCCAL step, halved on overshoot */
+#define CAL_GOOD	8	/* done within 0.8% */
+#define CAL_SAVE	20	/* store results within 2% */
+#define CAL_WAIT_US	20000	/* give up on a sync byte after this */
+#define CAL_CLI_BITS	32	/* interrupts off per sync byte, in bit times */
+#define CAL_IDLE_MS	5	/* sync bytes end when the line is quiet this long */
+
+#ifdef OSC_CAL
+
+void cal_init(void);
+void cal_run(void);
+uint8_t cal_boot(void);
+
+#endif
+
+#endif //__OSCCAL_H__
@@ -1,306 +1,850 @@
-/*****************************************************************************
- *
- * ps2_term.c - Main module for ps2_term app. This program will allow the use
- * of a standard PS2 keyboard with a Tiny4313 and LCD to form a simple serial
- * terminal using Futurlec style development board. This app uses modified 
- * versions of PFleury's LCD library (hacked to ignore R/W) and Jurre Hanema's
- * PS2KBD libraries. It is configured for FULL Duplex mode, what is typed on 
- * the PS2 keyboard is sent via the USART and what is received on the USART is 
- * displayed to the LCD. This version gets around the slow LCD and no RW by 
- * saving a copy of the incoming line to a buffer, as well as printing it to
- * the LCD. The code is arranged so that whenever a CR is received, the screen
- * is cleared, the line buffer is copied to the first line of the display and 
- * the cursor is moved to the second line to be ready to receive characters. 
- * As the characters are received, they are printed to the second line of the 
- * LCD and saved in the line buffer, where the next CR will cause the process
- * to repeat. Baud rate is currently fixed, but changeable via a define and
- * recompile. Echo and LF Add are variables. Control codes (CTRL-C, etc) are 
- * currently not supported. A different method of defining Scancode to ASCII
- * code conversions needs to be built. Not all PS2 keyboard keys are decoded,
- * mainly, letters, numbers, some punctuation and a few control keys (ENTER, 
- * BACKSPACE). Code space utilization is at ~65% on a Tiny4313.
- * 
- * (C) 2012 KB4OID Labs, a division of Kodetroll Heavy Industries.
- * All respective rights to their owners.
- *
- * Hardware connection info:
- * PS2 Keyboard connector:
- * Pin 	Name 	Dir 	Description
- *-----------------------------------
- * 1 	DATA 	<-> 	Key Data
- * 2 	n/c 	--- 	Not connected
- * 3 	GND 	--- 	Gnd
- * 4 	VCC 	--> 	Power , +5 VDC
- * 5 	CLK 	--> 	Clock
- * 6 	n/c 	--- 	Not connected
- * 
- * Note: Direction is Computer relative Keyboard.
- * 
- * To implement the PS2 Keyboard library, The Keyboard Clock line must be 
- * connected to PD3 (INT1), and the Data to PD4
- * CLK - PD3 (7)
- * DAT - PD4 (8)
- *
- * Futurlec EXP20 Connector Pinout to PS2 Keyboard connector pinout
- *  1 - VCC - PWR - 4
- * 14 - PD3 - CLK - 5
- * 16 - PD4 - DAT - 1
- * 20 - GND - GND - 3
- *
- * The LCD Display is connected via the futurlec LCD Display connector - J8
- *
- ******************************************************************************/
-
-#include "ps2_term.h"
-
-const char SignOnString[] PROGMEM = "PS2 Keybd Term V0.99                    ";
-const char CopyrightString[] PROGMEM = "(C) 2012 KB4OID Labs";
-const char HexString[] PROGMEM = "0123456789ABCDEF";
-const char IDString[] PROGMEM = "@0104:0002:0000";
-const char CRLF[] PROGMEM = {0x0D, 0x0A, 0x00};
-
-uint8_t idx = 0;
-uint8_t echo = OFF;
-uint8_t lfadd = ON;
-
-char linebuf[LINE_SZ];
-
-
-/*************************************************************************
- * Low-level ISR function to receive a byte from the USART
- *
- * Input:    USART RX Vector
- * Modifies: interrupts
- * Returns:  none
- *************************************************************************/
- 
-ISR ( USART_RX_vect )
-{
-	unsigned char ReceivedByte;
-
-	// Disable interrupts
-	cli();
-
-	// Copy the received byte value 
-	ReceivedByte = UDR ; 
-
-	// Process the received character as type "COM"
-	process_char(COM, ReceivedByte);
-	
-	// re-enable interrupts
-	sei();
-}
-
-
-/*************************************************************************
- * Low-level function to clear the contents of the line buffer character
- * array.
- *
- * Input:    none
- * Modifies: global linebuf*
- * Returns:  none
- * 
- *************************************************************************/
-
-void clr_buf(void)
-{
-	uint8_t i = 0;
-
-	// Start with an empty linebuf
-	for (i=0;i<LINE_SZ;i++)
-		linebuf[i] = 0x00;
-
-}
-
-/*************************************************************************
- * Function to send pre-defined instrument ID string to USART. This allows
- * a system connected to this device to identify the type of device 
- * attached.  The ID string is stored in PROGMEM.
- *
- * Input:    none
- * Modifies: none
- * Returns:  none
- * 
- *************************************************************************/
-
-void send_id(void)
-{
-	// copy ID to USART
-	SendSTR_P(IDString);
-
-	// copy CR LF to USART
-	SendSTR_P(CRLF);
-}
-
-/*************************************************************************
- * Function to send pre-defined header and copyright strings to the USART
- * These strings are stored in PROGMEM.
- *
- * Input:    none
- * Modifies: none
- * Returns:  none
- * 
- *************************************************************************/
-
-void send_signon(void)
-{
-	// copy Welcome Header to USART
-	SendSTR_P(SignOnString);
-	SendSTR_P(CRLF);
-
-	// copy (C) Header to USART
-	SendSTR_P(CopyrightString);
-	SendSTR_P(CRLF);
-
-	// Send ID string to USART
-	send_id();
-
-    /* initialize display, cursor off */
-    lcd_init(LCD_DISP_ON);
-
-	/* clear display and home cursor */
-	lcd_clrscr();
-
-	/* put signong string to LCD display (line 1) with linefeed */
-	lcd_puts_p(SignOnString);
-	
-	/* put (C) string to LCD display (line 2) with linefeed */
-	lcd_puts_p(CopyrightString);
-	
-}
-
-/*************************************************************************
- * Function to process a received byte (either keyboard or serial) based
- * on type.
- *
- * Input:	uint8_t source
- *			unsigned char c 
- * Modifies: global linebuf, writes to USART and LCD
- * Returns:  none
- * 
- *************************************************************************/
-
-void process_char(uint8_t source, unsigned char c)
-{
-	// If C is a Carriage Return
-	if (c == CR)
-	{
-		if (source == COM || (source == KBD && echo == ON))
-		{
-
-			// properly terminate the buffer
-			linebuf[idx] = 0x00;
-
-			// clear the LCD screen (and cursor to 0,0)
-			lcd_clrscr();
-
-			// move the cursor to line 2
-			lcd_gotoxy(0,0);
-
-			// copy the current contents of the line
-			// buffer to the first line of the LCD 
-			lcd_puts(linebuf);
-				
-			// move the cursor to line 2
-			lcd_gotoxy(0,1);
-				
-			// clear the line buffer to make room for the next line
-			clr_buf();
-
-			// reset the current char index to beginning of the buffer
-			idx = 0;
-		}
-		
-		// copy the char to the USART 
-		if (source == KBD || (source == COM && echo == ON))
-		{
-			UART_putc(c);
-
-			// Add a LF, if defined
-			if (lfadd)
-				UART_putc(LF);
-		}
-		// reset the char to 0x00
-		c = 0;
-
-	}
-	else			
-	{
-		// char was NOT a CR, so
-		// write char to current cursor position
-		// on LCD display
-		if (source == COM || (source == KBD && echo == ON))
-		{
-			lcd_putc(c);
-
-			// add the char to the line buffer 
-			// and increment the index pointer
-			linebuf[idx++] = c;
-
-			// handle (crudly) index past end of buffer
-			if (idx > LINE_SZ-1)
-				idx = LINE_SZ-1;
-		}
-
-		// echo the char to the USART
-		if (source == KBD || (source == COM && echo == ON))
-			UART_putc(c);
-
-	}
-}
-
-int main(void)
-{
-	unsigned char c = 0;
-	
-	echo = OFF;
-	lfadd = ON;
-	
-	// Initialize the PS2 Keyboard queue
-	kbd_init();
-	
-	// Initialize the LCD display
-	lcd_init(LCD_DISP_ON);
-	
-	// Initialize the USART to the specified BAUD rate
-	UART_init(BAUD);
-
-	// Initiate Interrupts
-	sei ();
-
-	// Send the wordy damn signon message
-	send_signon();
-
-	// Show it for 3 seconds
-	_delay_ms(3000);
-	
-	idx = 0;
-
-	// properly terminate linebuf (JIC)
-	linebuf[idx] = 0x00;
-	
-	// Clear the LCD screen
-	lcd_clrscr();
-	
-	// copy the contents of the linebuf to the 
-	// first line of the LCD display
-	lcd_puts(linebuf);
-	
-	// put the cursor on the second (bottom) 
-	// line of the LCD display.
-	lcd_gotoxy(0,1);
-	
-	// clear the linebuf
-	clr_buf();
-
-	// start the terminal loop
-	while(1)
-	{
-		// if c is other than 0x00, then 
-		while((c = kbd_getchar()))
-			process_char(KBD,c);
-
-	}
-
-	return 0;
-}
+/*****************************************************************************
+ *
+ * ps2_term.c - Main module for ps2_term app. This program will allow the use
+ * of a standard PS2 keyboard with a Tiny4313 and LCD to form a simple serial
+ * terminal using Futurlec style development board. This app uses modified 
+ * versions of PFleury's LCD library (hacked to ignore R/W) and Jurre Hanema's
+ * PS2KBD libraries. It is configured for FULL Duplex mode, what is typed on 
+ * the PS2 keyboard is sent via the USART and what is received on the USART is 
+ * displayed to the LCD. Received characters are printed at the cursor, which
+ * the LCD driver tracks in software. A CR, or a line running past the end,
+ * moves to the start of the next line; on the last line the display scrolls
+ * up. The slow LCD (no RW) is kept out of the way: characters to display go
+ * into a queue that a low priority task draws, one LCD write at a time, so
+ * the keyboard and host paths never wait for it. Baud rate is currently
+ * fixed, but changeable via a define and recompile. Echo and LF Add are
+ * variables. Control codes (CTRL-C, etc) are currently not supported.
+ * Scancode to character conversion is table driven, the tables are
+ * compiled from the text keymaps in keymaps/ (US, UK and DE, selected
+ * with KEYMAP in the Makefile). Cursor, editing and function keys send
+ * VT100 sequences. The RX ISR only queues the received bytes; keyboard
+ * decode and RX processing run as tasks under the cooperative scheduler in
+ * sched.c, keyboard first. How much code space the options take on each
+ * part is printed by make (avr-size).
+ * 
+ * (C) 2012 KB4OID Labs, a division of Kodetroll Heavy Industries.
+ * All respective rights to their owners.
+ *
+ * Hardware connection info:
+ * PS2 Keyboard connector:
+ * Pin 	Name 	Dir 	Description
+ *-----------------------------------
+ * 1 	DATA 	<-> 	Key Data
+ * 2 	n/c 	--- 	Not connected
+ * 3 	GND 	--- 	Gnd
+ * 4 	VCC 	--> 	Power , +5 VDC
+ * 5 	CLK 	--> 	Clock
+ * 6 	n/c 	--- 	Not connected
+ * 
+ * Note: Direction is Computer relative Keyboard.
+ * 
+ * To implement the PS2 Keyboard library, The Keyboard Clock line must be 
+ * connected to PD3 (INT1), and the Data to PD4
+ * CLK - PD3 (7)
+ * DAT - PD4 (8)
+ *
+ * Futurlec EXP20 Connector Pinout to PS2 Keyboard connector pinout
+ *  1 - VCC - PWR - 4
+ * 14 - PD3 - CLK - 5
+ * 16 - PD4 - DAT - 1
+ * 20 - GND - GND - 3
+ *
+ * The LCD Display is connected via the futurlec LCD Display connector - J8
+ *
+ ******************************************************************************/
+
+#include "ps2_term.h"
+
+const char SignOnString[] PROGMEM = "PS2 Keybd Term V0.99                    ";
+const char CopyrightString[] PROGMEM = "(C) 2012 KB4OID Labs";
+const char IDString[] PROGMEM = "@0104:0002:0000";
+const char CRLF[] PROGMEM = {0x0D, 0x0A, 0x00};
+
+uint8_t echo NOINIT;		// settings and counters survive a watchdog reset
+uint8_t lfadd NOINIT;
+uint8_t keys NOINIT;		// KEYS_CHAR, or send key events (ESC 9, ESC :)
+uint8_t esc = OFF;
+#ifdef RS485
+uint8_t set_addr = OFF;		// next byte is the new RS-485 address
+#endif
+
+volatile uint16_t rx_bytes NOINIT;
+volatile uint8_t rx_overruns NOINIT;
+volatile uint8_t rx_framing NOINIT;
+volatile uint8_t rx_dropped NOINIT;
+
+// RX ring, filled by the ISR and emptied by task_rx()
+volatile unsigned char rx_buf[RX_BUFSIZE];
+volatile uint8_t rx_head = 0;
+volatile uint8_t rx_tail = 0;
+
+// Display queue, filled by process_char() and drawn by task_lcd()
+unsigned char disp_buf[DISP_BUFSIZE];
+uint8_t disp_head = 0;
+uint8_t disp_tail = 0;
+uint8_t disp_high = 0;		// most bytes ever waiting, for the stats
+
+// Main loop tasks, highest priority first. task_rx comes after task_lcd
+// and only runs once the display has caught up, so the screen is drawn in
+// the order the bytes arrived.
+const sched_task_t tasks[] PROGMEM = { task_kbd, task_lcd, task_rx };
+
+
+/*************************************************************************
+ * Low-level ISR function to receive a byte from the USART. The byte is
+ * only queued, task_rx() processes it.
+ *
+ * Input:    USART RX Vector
+ * Modifies: rx_buf, rx_head, statistics
+ * Returns:  none
+ *************************************************************************/
+ 
+ISR ( HAL_USART_RX_vect )
+{
+	unsigned char ReceivedByte;
+	uint8_t status;
+#ifdef RS485
+	uint8_t bit9;
+#endif
+
+	TRACE_EVENT(TR_RX);
+
+	// Error flags, and the 9th bit, are only valid until UDR is read
+	status = HAL_UCSRA;
+#ifdef RS485
+	bit9 = HAL_UCSRB & _BV(HAL_RXB8);
+#endif
+
+	// Copy the received byte value 
+	ReceivedByte = HAL_UDR ; 
+
+	rx_bytes++;
+	if (status & (_BV(HAL_DOR) | _BV(HAL_FE)))
+	{
+		if (status & _BV(HAL_DOR))
+			rx_overruns++;
+		if (status & _BV(HAL_FE))
+			rx_framing++;
+	}
+
+#ifdef RS485
+	// Addresses, and data for other units, stop here
+	if (!rs485_rx(ReceivedByte, bit9))
+		return;
+#endif
+
+	REC_EVENT(0, ReceivedByte);
+	rx_put(ReceivedByte);
+}
+
+/*************************************************************************
+ * Low-level function to queue a received byte for task_rx(), or drop it
+ * if task_rx() has fallen too far behind. Called from the RX ISR, and
+ * with interrupts off by the replay.
+ *
+ * Input:    unsigned char c
+ * Modifies: rx_buf, rx_head, rx_dropped
+ * Returns:  none
+ *************************************************************************/
+
+void rx_put(unsigned char c)
+{
+	uint8_t h = rx_head;
+	uint8_t n = (h + 1) & (RX_BUFSIZE - 1);
+
+	if (n == rx_tail)
+	{
+		rx_dropped++;
+		return;
+	}
+	rx_buf[h] = c;
+	rx_head = n;
+
+	LAT_RX(h);
+}
+
+
+/*************************************************************************
+ * Low-level function to queue a byte for the display. A CR moves the
+ * second line up, anything else is printed at the cursor. The byte is
+ * dropped if the queue is full.
+ *
+ * Input:    unsigned char c
+ * Modifies: disp_buf, disp_head, disp_high
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void disp_put(unsigned char c)
+{
+	uint8_t h = disp_head;
+	uint8_t n = (h + 1) & (DISP_BUFSIZE - 1);
+	uint8_t used;
+
+	if (n == disp_tail)
+		return;
+
+	disp_buf[h] = c;
+	disp_head = n;
+
+	used = (n - disp_tail) & (DISP_BUFSIZE - 1);
+	if (used > disp_high)
+		disp_high = used;
+}
+
+/*************************************************************************
+ * Function to send pre-defined instrument ID string to USART. This allows
+ * a system connected to this device to identify the type of device 
+ * attached.  The ID string is stored in PROGMEM.
+ *
+ * Input:    none
+ * Modifies: none
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void send_id(void)
+{
+	// copy ID to USART
+	SendSTR_P(IDString);
+
+	// copy CR LF to USART
+	SendSTR_P(CRLF);
+}
+
+/*************************************************************************
+ * Function to send the statistics report to the USART, in reply to
+ * ESC CMD_STATS. The report is "S" followed by hex fields and CR LF:
+ *
+ *   S rrrr oo ff kkkk ee pp qq dd hh ll uuuu cc ww
+ *
+ *   rrrr  serial bytes received     kkkk  keyboard bytes received
+ *   oo    serial overruns (DOR)     ee    keyboard framing errors
+ *   ff    serial framing errors     pp    keyboard parity errors
+ *   dd    RX ring drops             qq    kbd_queue overflows
+ *   hh    TX ring high water        ll    display queue high water
+ *   uuuu  stack bytes never used (see stack.h)
+ *   cc    MCUSR at the last reset   ww    watchdog resets (see wdog.h)
+ *
+ * Input:    none
+ * Modifies: none
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void send_stats(void)
+{
+	uint16_t n, rx, frames;
+	uint8_t sreg = SREG;
+
+	// The ISRs count these, copy them whole before sending them a byte at a time
+	cli();
+	rx = rx_bytes;
+	frames = kbd_frames;
+	SREG = sreg;
+
+	UART_putc('S');
+	UART_putc(' ');
+	UART_puthex(rx >> 8);
+	UART_puthex(rx);
+	UART_putc(' ');
+	UART_puthex(rx_overruns);
+	UART_putc(' ');
+	UART_puthex(rx_framing);
+	UART_putc(' ');
+	UART_puthex(frames >> 8);
+	UART_puthex(frames);
+	UART_putc(' ');
+	UART_puthex(kbd_errors);
+	UART_putc(' ');
+	UART_puthex(kbd_parity_errors);
+	UART_putc(' ');
+	UART_puthex(kbd_overflows);
+	UART_putc(' ');
+	UART_puthex(rx_dropped);
+	UART_putc(' ');
+	UART_puthex(tx_high);
+	UART_putc(' ');
+	UART_puthex(disp_high);
+	UART_putc(' ');
+	n = stack_unused();
+	UART_puthex(n >> 8);
+	UART_puthex(n);
+	UART_putc(' ');
+	UART_puthex(wdog_cause);
+	UART_putc(' ');
+	UART_puthex(wdog_resets);
+	SendSTR_P(CRLF);
+}
+
+#if LCD_SHADOW
+/*************************************************************************
+ * Function to send what is on the display, from the shadow copy kept by
+ * lcd_norw.c, in reply to ESC CMD_SCREEN. A header line
+ *
+ *   V ll cc yy xx ss mm
+ *
+ *   ll  lines               yy xx  cursor line and column
+ *   cc  columns per line    ss     columns the display is shifted left
+ *   mm  mode flags, MODE_ECHO, MODE_LFADD and MODE_UTF8
+ *
+ * is followed by ll lines of exactly cc bytes, each with CR LF after it.
+ * The bytes are the codes written to the LCD and can be anything, CR and
+ * LF included, so count them rather than look for the CR.
+ *
+ * Input:    none
+ * Modifies: none
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void send_screen(void)
+{
+	uint8_t i, j;
+	uint8_t m = 0;
+
+	if (echo == ON)
+		m |= MODE_ECHO;
+	if (lfadd == ON)
+		m |= MODE_LFADD;
+#ifdef UTF8
+	m |= MODE_UTF8;
+#endif
+	if (keys != KEYS_CHAR)
+		m |= MODE_KEYS;
+
+	UART_putc('V');
+	UART_putc(' ');
+	UART_puthex(LCD_LINES);
+	UART_putc(' ');
+	UART_puthex(LCD_SHADOW_LENGTH);
+	UART_putc(' ');
+	UART_puthex(lcd_y);
+	UART_putc(' ');
+	UART_puthex(lcd_x);
+	UART_putc(' ');
+#if LCD_HSCROLL
+	UART_puthex(lcd_shift);
+#else
+	UART_puthex(0);
+#endif
+	UART_putc(' ');
+	UART_puthex(m);
+	SendSTR_P(CRLF);
+
+	for (j = 0; j < LCD_LINES; j++)
+	{
+		for (i = 0; i < LCD_SHADOW_LENGTH; i++)
+			UART_putc(lcd_shadow[j][i]);
+		SendSTR_P(CRLF);
+	}
+}
+#endif
+
+/*************************************************************************
+ * Function to send the waiting key events to the host in one frame, in
+ * the raw key modes (ESC CMD_KEYS_RAW and CMD_KEYS_TIME):
+ *
+ *   'E' n, then n times  ff cc, or  ff cc tl th  with time stamps
+ *
+ *   ff     KEV_ flags: 80 release, 40 E0 prefix, 08 AltGr, 04 Alt,
+ *          02 Ctrl, 01 Shift, the modifiers as held after the key
+ *   cc     set 2 scancode (set 3 codes are translated)
+ *   th tl  ms timer when the key's last byte came in, see sched.h
+ *
+ * n and the events are binary. Keys that come in together go out in
+ * one frame.
+ *
+ * Input:    none
+ * Modifies: none
+ * Returns:  1 if a frame was sent, 0 if there were no events
+ * 
+ *************************************************************************/
+
+uint8_t send_keys(void)
+{
+	kbd_event_t ev;
+	uint8_t n;
+
+	if (!(n = kbd_events()))
+		return 0;
+
+	UART_putc('E');
+	UART_putc(n);
+	while (n--)
+	{
+		kbd_get_event(&ev);
+		UART_putc(ev.flags);
+		UART_putc(ev.code);
+#ifdef KBD_EVTIME
+		if (keys == KEYS_TIME)
+		{
+			UART_putc(ev.t);
+			UART_putc(ev.t >> 8);
+		}
+#endif
+	}
+	return 1;
+}
+
+/*************************************************************************
+ * Function to send pre-defined header and copyright strings to the USART
+ * These strings are stored in PROGMEM.
+ *
+ * Input:    none
+ * Modifies: none
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void send_signon(void)
+{
+	// copy Welcome Header to USART
+	SendSTR_P(SignOnString);
+	SendSTR_P(CRLF);
+
+	// copy (C) Header to USART
+	SendSTR_P(CopyrightString);
+	SendSTR_P(CRLF);
+
+	// Send ID string to USART
+	send_id();
+
+    /* initialize display, cursor off */
+    lcd_init(LCD_DISP_ON);
+
+	/* clear display and home cursor */
+	lcd_clrscr();
+
+	/* put signong string to LCD display (line 1) with linefeed */
+	lcd_puts_p(SignOnString);
+	
+	/* put (C) string to LCD display (line 2) */
+	lcd_gotoxy(0,1);
+	lcd_puts_p(CopyrightString);
+	
+}
+
+/*************************************************************************
+ * Function to process a received byte (either keyboard or serial) based
+ * on type.
+ *
+ * Input:	uint8_t source
+ *			unsigned char c 
+ * Modifies: writes to USART, queues for the LCD
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void process_char(uint8_t source, unsigned char c)
+{
+#ifdef RS485
+	// ESC 7 takes the next byte as the address, whatever it is
+	if (source == COM && set_addr == ON)
+	{
+		set_addr = OFF;
+		rs485_set_addr(c);
+		return;
+	}
+#endif
+
+#ifdef SCREEN_PROTO
+	// Binary screen update frames start with DLE
+	if (source == COM && screen_rx(c))
+		return;
+#endif
+
+#ifdef REPLAY
+	// A capture being loaded takes everything up to CR
+	if (source == COM && rec_state == REC_LOAD)
+	{
+		rec_load(c);
+		return;
+	}
+#endif
+
+	// Host commands are ESC followed by a command byte
+	if (source == COM)
+	{
+		if (esc == ON)
+		{
+			esc = OFF;
+
+			if (c == CMD_IDENTIFY)
+			{
+				send_id();
+				return;
+			}
+			if (c == CMD_STATS)
+			{
+				send_stats();
+				return;
+			}
+#if LCD_SHADOW
+			if (c == CMD_SCREEN)
+			{
+				send_screen();
+				return;
+			}
+#endif
+			if (c == CMD_KEYS_RAW)
+			{
+				keys = KEYS_RAW;
+				kbd_set_raw(1);
+				return;
+			}
+#ifdef KBD_EVTIME
+			if (c == CMD_KEYS_TIME)
+			{
+				keys = KEYS_TIME;
+				kbd_set_raw(1);
+				return;
+			}
+#endif
+			if (c == CMD_KEYS_CHAR)
+			{
+				keys = KEYS_CHAR;
+				kbd_set_raw(0);
+				return;
+			}
+#ifdef TRACE
+			if (c == CMD_TRACE)
+			{
+				trace_dump();
+				return;
+			}
+#endif
+#ifdef LATENCY
+			if (c == CMD_LATENCY)
+			{
+				lat_report();
+				return;
+			}
+#endif
+#ifdef REPLAY
+			if (c == CMD_RECORD)
+			{
+				rec_start();
+				return;
+			}
+			if (c == CMD_DUMP)
+			{
+				rec_dump();
+				return;
+			}
+			if (c == CMD_REPLAY)
+			{
+				rec_replay();
+				return;
+			}
+			if (c == CMD_LOAD)
+			{
+				rec_load_start();
+				return;
+			}
+#endif
+#ifdef OSC_CAL
+			if (c == CMD_CALIBRATE)
+			{
+				cal_run();
+				rx_tail = rx_head;	// sync bytes taken before the receiver went off
+				return;
+			}
+#endif
+#ifdef RS485
+			if (c == CMD_ADDRESS)
+			{
+				set_addr = ON;
+				return;
+			}
+#endif
+		}
+		else if (c == ESC)
+		{
+			esc = ON;
+			return;
+		}
+	}
+
+	// Send first, so a keystroke never waits for the display
+	if (source == KBD || echo == ON)
+	{
+#ifdef UTF8
+		// Keys are Latin-1, the host wants UTF-8
+		if (source == KBD)
+			utf8_putc(c);
+		else
+#endif
+		UART_putc(c);
+
+		// Add a LF after a CR, if defined
+		if (c == CR && lfadd)
+			UART_putc(LF);
+	}
+
+	// then queue the local copy, task_lcd() draws it
+	if (source == COM || echo == ON)
+	{
+#ifdef UTF8
+		// One ROM code per character, nothing until a sequence is complete
+		if (source == COM)
+			c = utf8_rx(c);
+		else if (c >= 0x80)
+			c = utf8_rom(c);
+		if (!c)
+			return;
+#endif
+		disp_put(c);
+	}
+}
+
+/*************************************************************************
+ * Function to replace the sign-on screen with the terminal screen. Runs
+ * from the scheduler once the sign-on has been shown for 3 seconds.
+ *
+ * Input:    none
+ * Modifies: display queue, LCD
+ * Returns:  none
+ * 
+ *************************************************************************/
+
+void show_terminal(void)
+{
+	// Anything typed over the sign-on goes with it
+	disp_tail = disp_head;
+
+	// Clear the LCD screen
+	lcd_clrscr();
+	
+	// put the cursor on the second (bottom) 
+	// line of the LCD display.
+	lcd_gotoxy(0,1);
+}
+
+/*************************************************************************
+ * Keyboard task: take one key event and send what it stands for on.
+ * Ctrl with a letter or one of @ [ \ ] ^ _ gives the control code, and
+ * Ctrl-space gives NUL. In the raw key modes the events are sent as they
+ * are instead, see send_keys(). Runs ahead of task_rx() so typing is
+ * never held up by host traffic.
+ *
+ * Input:    none
+ * Modifies: see process_char()
+ * Returns:  1 if an event was taken, 0 if there was nothing to do
+ * 
+ *************************************************************************/
+
+uint8_t task_kbd(void)
+{
+	kbd_event_t ev;
+	const unsigned char *seq;
+	unsigned char c;
+
+	LAT_RUN_START();
+	if (keys != KEYS_CHAR)
+	{
+		c = send_keys();
+		LAT_RUN_END(LAT_KEY, 0);
+		return c;
+	}
+	if (!kbd_get_event(&ev))
+	{
+		LAT_RUN_END(LAT_KEY, 0);
+		return 0;
+	}
+
+	// Releases, modifiers and locks send nothing
+	c = ev.c;
+	if ((ev.flags & KEV_BREAK) || !c)
+	{
+		LAT_RUN_END(LAT_KEY, 0);
+		return 1;
+	}
+
+	LAT_KEY_MARK();
+	if ((seq = kbd_sequence(c)))
+	{
+		while ((c = pgm_read_byte(seq++)))
+			process_char(KBD, c);
+	}
+	else
+	{
+		if (ev.flags & KEV_CTRL)
+		{
+			if ((c >= '@' && c <= '_') || (c >= 'a' && c <= 'z'))
+				c &= 0x1f;
+			else if (c == ' ')
+				c = NUL;
+		}
+		process_char(KBD, c);
+	}
+	LAT_RUN_END(LAT_KEY, ev.c);
+	return 1;
+}
+
+/*************************************************************************
+ * Display task: one step of drawing the display queue, if the LCD is
+ * ready for it. A CR, or a character that doesn't fit on the line any
+ * more (LCD_WRAP_LINES), moves to the next line; on the last line that
+ * scrolls the display up, one changed cell per step. Lines can run to
+ * LCD_SHADOW_LENGTH, the display is shifted to follow the cursor.
+ *
+ * Input:    none
+ * Modifies: display queue, LCD
+ * Returns:  1 if the LCD was written to, 0 if busy or nothing to do
+ * 
+ *************************************************************************/
+
+uint8_t task_lcd(void)
+{
+	uint8_t t;
+	unsigned char c;
+
+	if (lcd_busy())
+		return 0;
+
+	// finish a scroll first
+	if (lcd_scroll_step())
+		return 1;
+
+#if LCD_HSCROLL
+	// keep the cursor in view, one display shift per turn
+	if (lcd_hscroll(lcd_x))
+		return 1;
+#endif
+
+	t = disp_tail;
+	if (t == disp_head)
+	{
+		// caught up, so a timed received byte is on screen now
+		LAT_DISPLAYED();
+		return 0;
+	}
+
+	c = disp_buf[t];
+
+#if LCD_SHADOW && LCD_WRAP_LINES
+	if (c != CR && lcd_x >= LCD_SHADOW_LENGTH)
+	{
+		// wrap, the byte stays queued for the new line
+		lcd_newline();
+		return 1;
+	}
+#endif
+
+	disp_tail = (t + 1) & (DISP_BUFSIZE - 1);
+
+	if (c == CR)
+#if LCD_SHADOW
+		lcd_newline();
+#else
+		lcd_gotoxy(0, LCD_LINES - 1);	// no cursor to follow, start the bottom line again
+#endif
+	else
+		lcd_putc(c);	// dropped by the driver if the line is full
+
+	return 1;
+}
+
+/*************************************************************************
+ * RX task: process one byte from the RX ring, once the display queue is
+ * empty.
+ *
+ * Input:    none
+ * Modifies: rx_tail, see process_char()
+ * Returns:  1 if a byte was processed, 0 if the ring was empty or the
+ *           display is still catching up
+ * 
+ *************************************************************************/
+
+uint8_t task_rx(void)
+{
+	uint8_t t = rx_tail;
+	unsigned char c;
+
+	if (t == rx_head || disp_tail != disp_head || lcd_scrolling)
+		return 0;
+
+	c = rx_buf[t];
+	rx_tail = (t + 1) & (RX_BUFSIZE - 1);
+
+	// Process the received character as type "COM"
+	LAT_RX_TAKE(t);
+	LAT_RUN_START();
+	process_char(COM, c);
+	LAT_RUN_END(LAT_RUN_RX, c);
+
+	// only time bytes that have something to display
+	if (disp_tail == disp_head)
+		LAT_RX_DONE();
+	return 1;
+}
+
+int main(void)
+{
+	// After a watchdog reset the settings are still in .noinit
+	if (!wdog_warm)
+	{
+		echo = OFF;
+		lfadd = ON;
+		keys = KEYS_CHAR;
+	}
+	
+#ifdef OSC_CAL
+	// Back to the clock the host was last tuned to, before anything is timed
+	cal_init();
+#endif
+
+	// Start the Timer1 time base, the LCD busy timing depends on it
+	clock_init();
+
+	// Start the millisecond tick, which also times out PS/2 frames
+	sched_init();
+
+	// Initialize the PS2 Keyboard queue, raw keys may have survived a reset
+	kbd_init();
+	kbd_set_raw(keys != KEYS_CHAR);
+	
+	// Initialize the LCD display, or put back what was on it (only the
+	// shadow copy knows)
+#if LCD_SHADOW
+	if (wdog_warm)
+		lcd_restore(LCD_DISP_ON);
+	else
+#endif
+		lcd_init(LCD_DISP_ON);
+	
+	// Initialize the USART to the specified BAUD rate
+	UART_init(BAUD);
+
+	// Start the event trace
+	trace_init();
+
+	// Initiate Interrupts
+	sei ();
+
+#ifdef OSC_CAL
+	// Sync bytes already coming in: the host wants the clock tuned before
+	// it can read anything, see osccal.h. Not after a watchdog reset, the
+	// host may be sending text then.
+	if (!wdog_warm && cal_boot())
+		rx_tail = rx_head;
+#endif
+
+	if (!wdog_warm)
+	{
+		// Send the wordy damn signon message
+		send_signon();
+
+		// Show it for 3 seconds, keys and host data are handled meanwhile
+		sched_after(3000, show_terminal);
+	}
+
+	// From here on the main loop has to keep going
+	wdog_start();
+
+	// start the terminal loop
+	sched_run(tasks, sizeof(tasks) / sizeof(tasks[0]));
+
+	return 0;
+}
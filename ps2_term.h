@@ -1,87 +1,150 @@
-/*****************************************************************************
- *
- * ps2_term.h - Main module for ps2_term app. This program will allow the use
- * of a standard PS2 keyboard with a Tiny4313 and LCD to form a simple serial
- * terminal using Futurlec style development board. This app uses modified 
- * versions of PFleury's LCD library (hacked to ignore R/W) and Jurre Hanema's
- * PS2KBD libraries. It is configured for FULL Duplex mode, what is typed on 
- * the PS2 keyboard is sent via the USART and what is received on the USART is 
- * displayed to the LCD. This version gets around the slow LCD and no RW by 
- * saving a copy of the incoming line to a buffer, as well as printing it to
- * the LCD. The code is arranged so that whenever a CR is received, the screen
- * is cleared, the line buffer is copied to the first line of the display and 
- * the cursor is moved to the second line to be ready to receive characters. 
- * As the characters are received, they are printed to the second line of the 
- * LCD and saved in the line buffer, where the next CR will cause the process
- * to repeat. Baud rate is currently fixed, but changeable via a define and
- * recompile. Echo and LF Add are variables. 
- * 
- * (C) 2012 KB4OID Labs, a division of Kodetroll Heavy Industries.
- * All respective rights to their owners.
- *
- * Hardware connection info:
- * PS2 Keyboard connector:
- * Pin 	Name 	Dir 	Description
- *-----------------------------------
- * 1 	DATA 	<-> 	Key Data
- * 2 	n/c 	--- 	Not connected
- * 3 	GND 	--- 	Gnd
- * 4 	VCC 	--> 	Power , +5 VDC
- * 5 	CLK 	--> 	Clock
- * 6 	n/c 	--- 	Not connected
- * 
- * Note: Direction is Computer relative Keyboard.
- * 
- * To implement this PS2 Keyboard library, The Keyboard Clock line must be 
- * connected to INT1 (PD3), and the data to PD4
- * CLK - PD3 (7)
- * DAT - PD4 (8)
- *
- * Futurlec EXP20 Connector Pinout to PS2 Keyboard connector pinout
- *  1 - VCC - PWR - 4
- * 14 - PD3 - CLK - 5
- * 16 - PD4 - DAT - 1
- * 20 - GND - GND - 3
- *
- * The LCD Display is connected via the futurlec LCD Display connector - J8
- *
- ******************************************************************************/
-
-#include <stdint.h>
-#include <stdlib.h>
-#include <stdio.h>
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
-#include <avr/pgmspace.h>
-
-#include "lcd_norw.h"
-#include "uart.h"
-#include "ps2kbd.h"
-#include "ascii.h"
-
-
-#ifndef __PS2_TERM_H__
-#define __PS2_TERM_H__
-
-#define ATtiny4313
-
-#define BAUD BR9600
-
-#define LINE_SZ 40
-
-#define LF_AFTER_CR
-
-#define KBD 1
-#define COM 0
-
-#define ON 1
-#define OFF 0
-
-void clr_buf(void);
-void send_id(void);
-void send_signon(void);
-void process_char(uint8_t source, unsigned char c);
-
+/*****************************************************************************
+ *
+ * ps2_term.h - Main module for ps2_term app. This program will allow the use
+ * of a standard PS2 keyboard with a Tiny4313 and LCD to form a simple serial
+ * terminal using Futurlec style development board. This app uses modified 
+ * versions of PFleury's LCD library (hacked to ignore R/W) and Jurre Hanema's
+ * PS2KBD libraries. It is configured for FULL Duplex mode, what is typed on 
+ * the PS2 keyboard is sent via the USART and what is received on the USART is 
+ * displayed to the LCD. This version gets around the slow LCD and no RW by 
+ * saving a copy of the incoming line to a buffer, as well as printing it to
+ * the LCD. The code is arranged so that whenever a CR is received, the screen
+ * is cleared, the line buffer is copied to the first line of the display and 
+ * the cursor is moved to the second line to be ready to receive characters. 
+ * As the characters are received, they are printed to the second line of the 
+ * LCD and saved in the line buffer, where the next CR will cause the process
+ * to repeat. Baud rate is currently fixed, but changeable via a define and
+ * recompile. Echo and LF Add are variables. 
+ * 
+ * (C) 2012 KB4OID Labs, a division of Kodetroll Heavy Industries.
+ * All respective rights to their owners.
+ *
+ * Hardware connection info:
+ * PS2 Keyboard connector:
+ * Pin 	Name 	Dir 	Description
+ *-----------------------------------
+ * 1 	DATA 	<-> 	Key Data
+ * 2 	n/c 	--- 	Not connected
+ * 3 	GND 	--- 	Gnd
+ * 4 	VCC 	--> 	Power , +5 VDC
+ * 5 	CLK 	--> 	Clock
+ * 6 	n/c 	--- 	Not connected
+ * 
+ * Note: Direction is Computer relative Keyboard.
+ * 
+ * To implement this PS2 Keyboard library, The Keyboard Clock line must be 
+ * connected to INT1 (PD3), and the data to PD4
+ * CLK - PD3 (7)
+ * DAT - PD4 (8)
+ *
+ * Futurlec EXP20 Connector Pinout to PS2 Keyboard connector pinout
+ *  1 - VCC - PWR - 4
+ * 14 - PD3 - CLK - 5
+ * 16 - PD4 - DAT - 1
+ * 20 - GND - GND - 3
+ *
+ * The LCD Display is connected via the futurlec LCD Display connector - J8
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <avr/pgmspace.h>
+
+#include "lcd_norw.h"
+#include "uart.h"
+#include "ps2kbd.h"
+#include "ascii.h"
+#include "clock.h"
+#include "trace.h"
+#include "screen.h"
+#include "sched.h"
+#include "latency.h"
+#include "replay.h"
+#include "stack.h"
+#include "wdog.h"
+#include "utf8.h"
+#include "osccal.h"
+
+
+#ifndef __PS2_TERM_H__
+#define __PS2_TERM_H__
+
+#define BAUD BR9600
+
+#ifndef DISP_BUFSIZE
+#define DISP_BUFSIZE 8	/* display queue, a power of 2; board profiles raise it */
+#endif
+
+#ifndef RX_BUFSIZE
+#define RX_BUFSIZE 16	/* RX ring, a power of 2; board profiles raise it */
+#endif
+
+#define LF_AFTER_CR
+
+#define KBD 1
+#define COM 0
+
+#define ON 1
+#define OFF 0
+
+// Host commands: ESC followed by one of these. ESC Z is the VT52/VT100
+// identify request, the others are private (ECMA-35 Fp) sequences. Any other
+// byte after ESC is processed as if the ESC wasn't there.
+
+#define CMD_IDENTIFY	'Z'		/* reply with the ID string */
+#define CMD_STATS	'0'		/* reply with the statistics report */
+#define CMD_TRACE	'1'		/* reply with the event trace, if compiled in */
+#define CMD_LATENCY	'2'		/* reply with the latency histograms, if compiled in */
+#define CMD_RECORD	'3'		/* start an input capture, see replay.h */
+#define CMD_DUMP	'4'		/* stop the capture and send it */
+#define CMD_REPLAY	'5'		/* replay the capture */
+#define CMD_LOAD	'6'		/* load a capture sent by the host */
+#define CMD_ADDRESS	'7'		/* the next byte is the RS-485 address, see uart.h */
+#define CMD_SCREEN	'8'		/* reply with the screen contents and cursor */
+#define CMD_KEYS_RAW	'9'		/* send key events instead of characters */
+#define CMD_KEYS_TIME	':'		/* the same with time stamps, if compiled in */
+#define CMD_KEYS_CHAR	';'		/* back to characters */
+#define CMD_CALIBRATE	'U'		/* tune OSCCAL to the 0x55 bytes that follow, see osccal.h */
+
+// What the keyboard sends to the host, see send_keys()
+
+#define KEYS_CHAR	0
+#define KEYS_RAW	1
+#define KEYS_TIME	2
+
+// Mode flags in the ESC 8 reply
+
+#define MODE_ECHO	0x01
+#define MODE_LFADD	0x02
+#define MODE_UTF8	0x04		/* the screen holds ROM codes of UTF-8 text */
+#define MODE_KEYS	0x08		/* keys are sent as events */
+
+// Serial statistics, updated from the RX ISR. They wrap.
+
+extern volatile uint16_t rx_bytes;	/* bytes received */
+extern volatile uint8_t rx_overruns;	/* DOR: a byte was lost, UDR not read in time */
+extern volatile uint8_t rx_framing;	/* FE: bad stop bit, usually a baud rate mismatch */
+extern volatile uint8_t rx_dropped;	/* bytes lost because the RX ring was full */
+
+void disp_put(unsigned char c);
+void rx_put(unsigned char c);
+void send_id(void);
+void send_stats(void);
+#if LCD_SHADOW
+void send_screen(void);
+#endif
+uint8_t send_keys(void);
+void send_signon(void);
+void process_char(uint8_t source, unsigned char c);
+void show_terminal(void);
+uint8_t task_kbd(void);
+uint8_t task_lcd(void);
+uint8_t task_rx(void);
+
 #endif // __PS2_TERM_H__
\ No newline at end of file
@@ -1,412 +1,775 @@
-/* PS/2 keyboard routines by Jurre Hanema, version 1.0
- * ps2kbd.c
- *
- * Released under "THE BEER-WARE LICENSE" (Revision 42):
- * <kipmans@gmail.com> wrote this file. As long as you retain this notice you can 
- * do whatever you want with this stuff. If we meet some day, and you think this 
- * stuff is worth it, you can buy me a beer in return.
- *
- *
- */
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
-#include <util/delay.h>
-
-#include "ps2kbd.h"
-#include "ascii.h"
-
-#define LOGIC_XOR(a, b)	(((a) && !(b)) || ((b) && !(a)))
-
-
-volatile uint8_t	kbd_bit_n = 1;
-volatile uint8_t	kbd_n_bits = 0;
-volatile uint8_t	kbd_buffer = 0;
-volatile uint8_t	kbd_queue[KBD_BUFSIZE + 1];
-volatile uint8_t	kbd_queue_idx = 0;
-volatile uint16_t	kbd_status = 0;
-
-const unsigned char lut_normal_keys[] PROGMEM = {
-
-	0x7c, '*',
-	0x7b, '-',
-	0x79, '+',
-	0x70, '0',
-	0x69, '1',
-	0x7a, '3',
-	0x73, '5',
-	0x6c, '7',
-	0x7d, '9',
-	0x71, '.',
-	0x75, DC1,	/* Arrow keys */
-	0x72, DC2,
-	0x6b, DC3,
-	0x74, DC4,
-	0x1C, 'a',
-	0x32, 'b',
-	0x21, 'c',
-	0x23, 'd',
-	0x24, 'e',
-	0x2B, 'f',
-	0x34, 'g',
-	0x33, 'h',
-	0x43, 'i',
-	0x3B, 'j',
-	0x42, 'k',
-	0x4B, 'l',
-	0x3A, 'm',
-	0x31, 'n',
-	0x44, 'o',
-	0x4D, 'p',
-	0x15, 'q',
-	0x2D, 'r',
-	0x1B, 's',
-	0x2C, 't',
-	0x3C, 'u',
-	0x2A, 'v',
-	0x1D, 'w',
-	0x22, 'x',
-	0x35, 'y',
-	0x1A, 'z',
-	0x45, '0',
-	0x16, '1',
-	0x1E, '2',
-	0x26, '3',
-	0x25, '4',
-	0x2E, '5',
-	0x36, '6',
-	0x3D, '7',
-	0x3E, '8',
-	0x46, '9',
-	0x29, ' ',
-	0X5A, CR,
-	0X66, BS,
-	0x0D, TAB,	
-	0X54, '[',
-	0X5B, ']',
-	0X4E, '-',
-	0X55, '=',
-	0X4C, ';',
-	0X52, 39,
-	0X0E, 44,
-	0X41, ',',
-	0X49, '.',
-	0X5D, 92,
-	0X4A, '/',
-	0, 0, 0
-};
-
-
-// Lookup table for 'normal' scancodes when SHIFT is held down
-// If no entry is found in this table, the uppercase equivalent of the result
-// from lut_normal_keys will be used.
-
-const unsigned char lut_normal_keys_shift[] PROGMEM = {
-	0x1C, 'A',
-	0x32, 'B',
-	0x21, 'C',
-	0x23, 'D',
-	0x24, 'E',
-	0x2B, 'F',
-	0x34, 'G',
-	0x33, 'H',
-	0x43, 'I',
-	0x3B, 'J',
-	0x42, 'K',
-	0x4B, 'L',
-	0x3A, 'M',
-	0x31, 'N',
-	0x44, 'O',
-	0x4D, 'P',
-	0x15, 'Q',
-	0x2D, 'R',
-	0x1B, 'S',
-	0x2C, 'T',
-	0x3C, 'U',
-	0x2A, 'V',
-	0x1D, 'W',
-	0x22, 'X',
-	0x35, 'Y',
-	0x1A, 'Z',
-	0x45, ')',
-	0x16, '!',
-	0x1E, '@',
-	0x26, '#',
-	0x25, '$',
-	0x2E, '%',
-	0x36, '^',
-	0x3D, '&',
-	0x3E, '*',
-	0x46, '(',
-	0x29, ' ',
-	0X5A, CR,
-	0X66, BS,
-	0X54, '{',
-	0X5B, '}',
-	0X4E, '_',
-	0X55, '+',
-	0X4C, ':',
-	0X52, 34,
-	0X0E, '~',
-	0X41, '<',
-	0X49, '>',
-	0X5D, '|',
-	0X4A, '?',
-	0, 0
-};
-
-
-// Lookup table for 'normal' scancodes when NUMLOCK is on
-// Can, for example, be used to change the behaviour of the keypad keys if desired
-
-const unsigned char lut_normal_keys_numlock[] PROGMEM = {
-	0x75, '8',
-	0x72, '2',
-	0x6b, '4',
-	0x74, '6',
-	0, 0
-};
-
-
-// Lookup table for 'extended' scancodes
-// Scancode without e0
-
-const unsigned char lut_extended_keys[] PROGMEM = {
-	0x4a, '/',
-	0x5a, 13,
-	0, 0
-};
-
-
-// Begin actual implementation
-
-void kbd_init(void)
-{
-	kbd_queue[KBD_BUFSIZE] = 0;
-	
-	// Set interrupts
-	
-	KBD_SET_INT();
-	KBD_EN_INT();
-	
-	// Enable pullup on clock
-	
-	KBD_CLOCK_PORT |= _BV(KBD_CLOCK_BIT);
-	
-	sei();
-}
-
-
-uint8_t kbd_kbd_queue_scancode(volatile uint8_t p)
-{
-	if(kbd_queue_idx < KBD_BUFSIZE)
-	{
-		kbd_queue[kbd_queue_idx] = p;
-		kbd_queue_idx++;
-	} else
-		return 0;
-
-	return 1;
-}
-
-
-uint8_t kbd_get_scancode(void)
-{
-	uint8_t		i;
-	uint8_t		tmp;
-
-	if(kbd_queue_idx > 0)
-	{
-		tmp = kbd_queue[kbd_queue_idx - 1]; 
-		
-		for(i = 0; i < KBD_BUFSIZE; i++)
-			kbd_queue[i] = kbd_queue[i + 1];
-		
-		kbd_queue_idx--;
-		
-		return tmp;
-	} else
-		return 0;
-}
-
-
-void kbd_send(uint8_t data)
-{
-	while(kbd_status & KBD_SEND) _delay_ms(5);	// This behaviour isn't the most desirable, but it's the easiest and proved to be reliable.
-	
-	// Initiate request-to-send, the actual sending of the data
-	// is handled in the ISR.
-	
-	KBD_CLOCK_PORT &= ~_BV(KBD_CLOCK_BIT);
-	KBD_CLOCK_DDR |= _BV(KBD_CLOCK_BIT);
-	_delay_us(120);
-	KBD_DATA_DDR |= _BV(KBD_DATA_BIT);
-	KBD_CLOCK_DDR &= ~_BV(KBD_CLOCK_BIT);
-	KBD_CLOCK_PORT |= _BV(KBD_CLOCK_BIT);
-	
-	kbd_bit_n = 1;
-	kbd_status |= KBD_SEND;
-	kbd_n_bits = 0;
-	kbd_buffer = data;
-}
-
-
-void kbd_update_leds(void)
-{
-	uint8_t	val = 0;
-
-	if(kbd_status & KBD_CAPS) val |= 0x04;
-	if(kbd_status & KBD_NUMLOCK) val |= 0x02;
-	if(kbd_status & KBD_SCROLL) val |= 0x01;
-	
-	kbd_send(0xed);
-	kbd_send(val);
-}
-
-
-unsigned char kbd_do_lookup(const unsigned char *lut, uint8_t sc)
-{
-	uint8_t	i;
-	
-	for(i = 0; pgm_read_byte(&lut[i]); i += 2)
-		if(sc == pgm_read_byte(&lut[i]))
-			return pgm_read_byte(&lut[i + 1]);
-	return 0;
-}
-
-
-unsigned char kbd_getchar(void)
-{
-	uint8_t		sc = 0;
-	unsigned char	c;
-	
-	while((sc = kbd_get_scancode()))
-	{
-		if(sc == 0xaa)
-			kbd_status |= KBD_BAT_PASSED;
-		else if(sc == 0xe0)
-			kbd_status |= KBD_EX;
-		else if(sc == 0xf0)
-			kbd_status |= KBD_BREAK;
-		else
-		{
-			if(kbd_status & KBD_BREAK)
-			{
-				kbd_status &= ~KBD_BREAK;
-				kbd_status &= ~KBD_EX;
-				
-				if(sc == 0x12 || sc == 0x59)	// Shift
-					kbd_status &= ~KBD_SHIFT;
-				else if(sc == 0x14)		// Ctrl
-					kbd_status &= ~KBD_CTRL;
-				else if(sc == 0x11)		// Alt
-					kbd_status &= ~KBD_ALT;
-				else if(sc == 0x77 || sc == 0x58 || sc == 0x7e)	// Caps lock, num lock or scroll lock
-					kbd_status &= ~KBD_LOCKED;
-			} else if(kbd_status & KBD_EX)
-			{
-				kbd_status &= ~KBD_EX;
-				
-				if(sc == 0x14)			// R ctrl
-					kbd_status |= KBD_CTRL;
-				else if(sc == 0x11)		// R alt
-					kbd_status |= KBD_ALT;
-				else if((c = kbd_do_lookup(lut_extended_keys, sc)))
-					return c;
-				//else
-				//	return sc;
-			} else
-			{
-				if(sc == 0x12 || sc == 0x59)	// Shift
-					kbd_status |= KBD_SHIFT;
-				else if(sc == 0x14)		// L ctrl
-					kbd_status |= KBD_CTRL;
-				else if(sc == 0x11)		// L alt
-					kbd_status |= KBD_ALT;
-				else if(sc == 0x77 && !(kbd_status & KBD_LOCKED))		// Num lock
-				{
-					kbd_status = (kbd_status & KBD_NUMLOCK) ? kbd_status & ~KBD_NUMLOCK : kbd_status | KBD_NUMLOCK;
-					kbd_status |= KBD_LOCKED;
-					kbd_update_leds();
-				} else if(sc == 0x58 && !(kbd_status & KBD_LOCKED))		// Caps lock
-				{
-					kbd_status = (kbd_status & KBD_CAPS) ? kbd_status & ~KBD_CAPS : kbd_status | KBD_CAPS;
-					kbd_status |= KBD_LOCKED;
-					kbd_update_leds();
-				} else if(sc == 0x7e && !(kbd_status & KBD_LOCKED))		// Scroll lock
-				{
-					kbd_status = (kbd_status & KBD_SCROLL) ? kbd_status & ~KBD_SCROLL : kbd_status | KBD_SCROLL;
-					kbd_status |= KBD_LOCKED;
-					kbd_update_leds();
-				} else
-				{
-					if((kbd_status & KBD_SHIFT) && (c = kbd_do_lookup(lut_normal_keys_shift, sc)))
-						return c;
-					else if((kbd_status & KBD_NUMLOCK) && (c = kbd_do_lookup(lut_normal_keys_numlock, sc)))
-						return c;
-					else if((c = kbd_do_lookup(lut_normal_keys, sc)))
-						return (LOGIC_XOR(kbd_status & KBD_SHIFT, kbd_status & KBD_CAPS) && (c >= 'a' && c <= 'z')) ? c - 32 : c;
-				}
-			}
-		}
-	}
-	
-	return 0;
-}
-
-
-uint16_t kbd_get_status(void)
-{
-	return kbd_status;
-}
-
-
-ISR(KBD_INT)
-{
-	if(kbd_status & KBD_SEND)
-	{
-		// Send data
-		
-		if(kbd_bit_n == 9)				// Parity bit
-		{
-			if(kbd_n_bits & 0x01)
-				KBD_DATA_DDR |= _BV(KBD_DATA_BIT);
-			else
-				KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);
-		} else if(kbd_bit_n == 10)			// Stop bit
-			KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);
-		else if(kbd_bit_n == 11)			// ACK bit, set by device
-		{
-			kbd_buffer = 0;
-			kbd_bit_n = 0;
-			kbd_status &= ~KBD_SEND;
-		} else					// Data bits
-		{
-			if(kbd_buffer & (1 << (kbd_bit_n - 1)))
-			{
-				KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);
-				kbd_n_bits++;
-			} else
-				KBD_DATA_DDR |= _BV(KBD_DATA_BIT);
-		}
-	} else
-	{
-		// Receive data
-		
-		if(kbd_bit_n > 0 && kbd_bit_n < 10)		// Ignore start, parity & stop bit
-		{
-			if(!bit_is_clear(KBD_DATA_PIN, KBD_DATA_BIT))
-				kbd_buffer |= (1 << (kbd_bit_n - 2));
-		} else if(kbd_bit_n == 11)
-		{
-			kbd_kbd_queue_scancode(kbd_buffer);
-			kbd_buffer = 0;
-			kbd_bit_n = 0;
-		}
-	}
-	
-	kbd_bit_n++;
-	
-	KBD_SET_INT();
-}
+/* PS/2 keyboard routines by Jurre Hanema, version 1.0
+ * ps2kbd.c
+ *
+ * Released under "THE BEER-WARE LICENSE" (Revision 42):
+ * <kipmans@gmail.com> wrote this file. As long as you retain this notice you can 
+ * do whatever you want with this stuff. If we meet some day, and you think this 
+ * stuff is worth it, you can buy me a beer in return.
+ *
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+
+#include "ps2kbd.h"
+#include "ascii.h"
+#include "trace.h"
+#include "sched.h"
+#include "latency.h"
+#include "replay.h"
+
+// Scancode tables, generated from keymaps/*.kmap by keymaps/mkkeymap.py
+
+#include "keymap.h"
+
+volatile uint8_t	kbd_bit_n = 1;
+volatile uint8_t	kbd_n_bits = 0;
+volatile uint8_t	kbd_buffer = 0;
+volatile uint8_t	kbd_queue[KBD_BUFSIZE];	/* Scancode ring, the ISR adds at the head */
+volatile uint8_t	kbd_queue_head = 0;
+volatile uint8_t	kbd_queue_tail = 0;
+volatile uint16_t	kbd_status = 0;
+volatile uint16_t	kbd_frames NOINIT;	/* Counters survive a watchdog reset */
+volatile uint8_t	kbd_errors NOINIT;
+volatile uint8_t	kbd_parity_errors NOINIT;
+volatile uint8_t	kbd_overflows NOINIT;
+volatile uint8_t	kbd_timeout = 0;
+uint8_t			kbd_txq[KBD_TXSIZE];	/* Waiting to be sent, oldest first */
+uint8_t			kbd_txn = 0;
+
+#if KMAP_LAYOUTS > 1
+uint8_t EEMEM		kbd_layout_ee = 0;	/* Layout picked at power-up */
+uint8_t			kbd_layout = 0;
+#else
+#define	kbd_layout	0
+#endif
+
+const unsigned char	*kbd_seq = 0;		/* Rest of a multi-byte sequence, in PROGMEM */
+uint8_t			kbd_skip = 0;		/* Codes left in a Pause sequence */
+kbd_event_t		kbd_evq[KBD_EVSIZE];	/* Decoded key events, oldest at kbd_ev_tail */
+uint8_t			kbd_ev_head = 0;
+uint8_t			kbd_ev_tail = 0;
+uint8_t			kbd_evn = 0;
+uint8_t			kbd_raw = 0;		/* No keymap lookups, see kbd_set_raw() */
+#ifdef KBD_EVTIME
+volatile uint16_t	kbd_queue_t[KBD_BUFSIZE];	/* sched_ms each scancode came in at */
+uint16_t		kbd_sc_t;		/* ...and the one kbd_get_scancode() took last */
+#endif
+const uint8_t		*kbd_cmd;		/* Command bytes still to go into kbd_txq, in PROGMEM */
+uint8_t			kbd_cmdn = 0;
+
+#ifdef KBD_SET3
+uint8_t			kbd_set3 = KBD_SET3_OFF;
+
+// Select set 3, then ask which set is in use
+
+static const uint8_t	kbd_set3_probe[] PROGMEM = { 0xf0, 0x03, 0xf0, 0x00 };
+
+// All keys make-only, then make/break for shift, ctrl, alt and the locks, and enable
+
+static const uint8_t	kbd_set3_keys[] PROGMEM = {
+	0xf9, 0xfc, 0x12, 0x59, 0x11, 0x58, 0x19, 0x39, 0x14, 0x76, 0x5f, 0xf4
+};
+
+// Set 3 codes that differ from set 2, with their set 2 code. Letters, digits and
+// most punctuation are the same in both.
+
+static const unsigned char kbd_set3_lut[] PROGMEM = {
+	0x08, 0x76,	0x07, 0x05,	0x0f, 0x06,	0x17, 0x04,	// Esc, F1-F3
+	0x1f, 0x0c,	0x27, 0x03,	0x2f, 0x0b,	0x37, 0x83,	// F4-F7
+	0x3f, 0x0a,	0x47, 0x01,	0x4f, 0x09,	0x56, 0x78,	// F8-F11
+	0x5e, 0x07,	0x5f, 0x7e,	0x5c, 0x5d,	0x13, 0x61,	// F12, scroll lock, \, ISO key
+	0x14, 0x58,	0x11, 0x14,	0x19, 0x11,	0x76, 0x77,	// Caps lock, L ctrl, L alt, num lock
+	0x7e, 0x7c,	0x84, 0x7b,	0x7c, 0x79,			// KP * - +
+	0, 0
+};
+
+// Set 3 codes of keys that have an e0 prefix in set 2
+
+static const unsigned char kbd_set3_ex[] PROGMEM = {
+	0x39, 0x11,	0x58, 0x14,	0x8b, 0x1f,	0x8c, 0x27,	// R alt, R ctrl, L win, R win
+	0x8d, 0x2f,	0x57, 0x7c,	0x67, 0x70,	0x6e, 0x6c,	// Menu, print screen, insert, home
+	0x6f, 0x7d,	0x64, 0x71,	0x65, 0x69,	0x6d, 0x7a,	// Page up, delete, end, page down
+	0x63, 0x75,	0x61, 0x6b,	0x60, 0x72,	0x6a, 0x74,	// Up, left, down, right
+	0x77, 0x4a,	0x79, 0x5a,					// KP / and enter
+	0, 0
+};
+
+static void kbd_set3_start(void);
+#endif
+
+
+// Begin actual implementation
+
+void kbd_init(void)
+{
+#if KMAP_LAYOUTS > 1
+	kbd_layout = eeprom_read_byte(&kbd_layout_ee);
+	if(kbd_layout >= KMAP_LAYOUTS)
+		kbd_layout = 0;
+#endif
+	
+	// Set interrupts
+	
+	KBD_SET_INT();
+#ifdef KBD_USI
+	KBD_USI_RESET();
+	KBD_USI_ON();					// INT1 only while sending
+#else
+	KBD_EN_INT();
+#endif
+	
+	// Enable pullup on clock
+	
+	KBD_CLOCK_PORT |= _BV(KBD_CLOCK_BIT);
+	
+#ifdef KBD_SET3
+	kbd_set3_start();				// Again when the keyboard sends its BAT code
+#endif
+	
+	sei();
+}
+
+
+uint8_t kbd_kbd_queue_scancode(volatile uint8_t p)
+{
+	uint8_t		h = kbd_queue_head;
+	uint8_t		n = (h + 1) & (KBD_BUFSIZE - 1);
+
+	if(n == kbd_queue_tail)
+		return 0;
+
+	kbd_queue[h] = p;
+#ifdef KBD_EVTIME
+	kbd_queue_t[h] = sched_ms;	// Interrupts are off, no need for sched_now()
+#endif
+	kbd_queue_head = n;
+
+	return 1;
+}
+
+
+// Takes the oldest scancode. The ISR only moves the head and never writes the
+// tail slot, so this needs no cli().
+
+uint8_t kbd_get_scancode(void)
+{
+	uint8_t		t = kbd_queue_tail;
+	uint8_t		tmp;
+
+	if(t == kbd_queue_head)
+		return 0;
+
+	tmp = kbd_queue[t];
+#ifdef KBD_EVTIME
+	kbd_sc_t = kbd_queue_t[t];
+#endif
+	kbd_queue_tail = (t + 1) & (KBD_BUFSIZE - 1);
+	
+	return tmp;
+}
+
+
+// End of request-to-send: take the clock hold off and let the keyboard clock the
+// first byte of kbd_txq out. The actual sending of the data is handled in the ISR.
+
+static void kbd_rts_done(void)
+{
+	uint8_t	i;
+	
+	kbd_buffer = kbd_txq[0];
+	for(i = 1; i < kbd_txn; i++)
+		kbd_txq[i - 1] = kbd_txq[i];
+	kbd_txn--;
+	
+	kbd_bit_n = 1;
+	kbd_n_bits = 0;
+	kbd_status = (kbd_status & ~KBD_RTS) | KBD_SEND;
+	
+	KBD_DATA_DDR |= _BV(KBD_DATA_BIT);
+	KBD_CLOCK_DDR &= ~_BV(KBD_CLOCK_BIT);
+	KBD_CLOCK_PORT |= _BV(KBD_CLOCK_BIT);
+	
+	HAL_EIFR = _BV(HAL_INTF1);			// Forget the edge we made ourselves
+	KBD_EN_INT();
+}
+
+
+// Starts request-to-send for the next queued byte if the line is free. The clock
+// has to be held low for at least 100 us, the scheduler times that.
+
+static void kbd_send_next(void)
+{
+	while(kbd_cmdn && kbd_txn < KBD_TXSIZE)
+	{
+		kbd_txq[kbd_txn++] = pgm_read_byte(kbd_cmd++);
+		kbd_cmdn--;
+	}
+	
+	if(!kbd_txn || (kbd_status & (KBD_SEND | KBD_RTS)))
+		return;
+	if(!sched_after(1, kbd_rts_done))
+		return;					// No free timer, try again next time
+	
+	HAL_EIMSK &= ~_BV(HAL_INT1);			// Don't take our own clock edge for a start bit
+	KBD_TIMEOUT_DISARM();
+	kbd_status |= KBD_RTS;
+	
+	KBD_CLOCK_PORT &= ~_BV(KBD_CLOCK_BIT);
+	KBD_CLOCK_DDR |= _BV(KBD_CLOCK_BIT);
+}
+
+
+uint8_t kbd_send(uint8_t data)
+{
+	if(kbd_txn >= KBD_TXSIZE)
+		return 0;
+	
+	kbd_txq[kbd_txn++] = data;
+	kbd_send_next();
+	
+	return 1;
+}
+
+
+#ifdef KBD_SET3
+// Queues a command sequence from PROGMEM, fed to kbd_txq as it empties. Replaces any
+// sequence that hasn't gone out yet.
+
+static void kbd_send_cmds(const uint8_t *cmd, uint8_t n)
+{
+	kbd_cmd = cmd;
+	kbd_cmdn = n;
+	kbd_send_next();
+}
+
+
+static void kbd_set3_start(void)
+{
+	kbd_set3 = KBD_SET3_PROBE;
+	kbd_send_cmds(kbd_set3_probe, sizeof(kbd_set3_probe));
+}
+#endif
+
+
+void kbd_update_leds(void)
+{
+	uint8_t	val = 0;
+
+	if(kbd_status & KBD_CAPS) val |= 0x04;
+	if(kbd_status & KBD_NUMLOCK) val |= 0x02;
+	if(kbd_status & KBD_SCROLL) val |= 0x01;
+	
+	if(kbd_txn > KBD_TXSIZE - 2)			// Keep the pair together, the LEDs catch up on the next change
+		return;
+	
+	kbd_send(0xed);
+	kbd_send(val);
+}
+
+
+unsigned char kbd_do_lookup(const unsigned char *lut, uint8_t sc)
+{
+	uint8_t	i;
+	
+	for(i = 0; pgm_read_byte(&lut[i]); i += 2)
+		if(sc == pgm_read_byte(&lut[i]))
+			return pgm_read_byte(&lut[i + 1]);
+	return 0;
+}
+
+
+void kbd_set_layout(uint8_t layout)
+{
+#if KMAP_LAYOUTS > 1
+	if(layout < KMAP_LAYOUTS)
+	{
+		kbd_layout = layout;
+		eeprom_update_byte(&kbd_layout_ee, layout);
+	}
+#endif
+}
+
+
+const unsigned char *kbd_table(uint8_t t)
+{
+	return (const unsigned char *)pgm_read_word(&kmap_layouts[kbd_layout][t]);
+}
+
+
+// Returns the PROGMEM string a keymap code stands for, or 0 if it is a plain
+// character.
+
+const unsigned char *kbd_sequence(unsigned char c)
+{
+	if(c >= KMAP_SEQ_BASE && c < KMAP_SEQ_BASE + KMAP_SEQ_N)
+		return &kmap_seq[pgm_read_byte(&kmap_seq_offs[c - KMAP_SEQ_BASE])];
+	return 0;
+}
+
+
+// Adds an event to kbd_evq, the caller has checked there is room. The held
+// modifiers are taken from kbd_status.
+
+static void kbd_ev_put(uint8_t code, uint8_t flags, unsigned char c)
+{
+	kbd_event_t	*ev = &kbd_evq[kbd_ev_head];
+	
+	if(c)
+		TRACE_EVENT(TR_KBD_DECODE);
+	
+	flags |= kbd_status & (KEV_SHIFT | KEV_CTRL | KEV_ALT);
+	if(kbd_status & KBD_ALTGR)
+		flags |= KEV_ALTGR;
+	
+	ev->code = code;
+	ev->flags = flags;
+	ev->c = c;
+#ifdef KBD_EVTIME
+	ev->t = kbd_sc_t;				// When its last byte came in
+#endif
+	kbd_ev_head = (kbd_ev_head + 1) & (KBD_EVSIZE - 1);
+	kbd_evn++;
+}
+
+
+// Decodes waiting scancodes into kbd_evq until it is full, one event per key
+// make or break. Prefixes, the keyboard's replies and lock key repeats make no
+// event.
+
+static void kbd_decode(void)
+{
+	uint8_t		sc = 0;
+	uint8_t		shift;
+	uint8_t		flags;
+	unsigned char	c;
+	
+	while(kbd_evn < KBD_EVSIZE && (sc = kbd_get_scancode()))
+	{
+		if(sc == 0xaa)
+		{
+			// The keyboard was reset or plugged in, nothing is held down
+			kbd_status = (kbd_status & ~(KBD_SHIFT | KBD_CTRL | KBD_ALT | KBD_ALTGR | KBD_EX | KBD_BREAK | KBD_LOCKED)) | KBD_BAT_PASSED;
+			kbd_skip = 0;
+#ifdef KBD_SET3
+			kbd_set3_start();			// Back in set 2 after a reset
+#endif
+		}
+#ifdef KBD_SET3
+		else if(kbd_set3 == KBD_SET3_PROBE)
+		{
+			// Skip the acks, the next byte is the set in use. Anything else, such as
+			// a resend request, means the keyboard doesn't do set 3.
+			
+			if(sc == 0xfa)
+				continue;
+			if(sc == 0x03)
+			{
+				kbd_set3 = KBD_SET3_ON;
+				kbd_send_cmds(kbd_set3_keys, sizeof(kbd_set3_keys));
+			} else
+				kbd_set3 = KBD_SET3_OFF;
+		}
+#endif
+		else if(sc == 0xe1)				// Pause: E1 14 77 E1 F0 14 F0 77
+			kbd_skip = 2;
+		else if(sc == 0xe0)
+			kbd_status |= KBD_EX;
+		else if(sc == 0xf0)
+			kbd_status |= KBD_BREAK;
+		else if(sc == 0xfa)				// Ack for a command we sent
+			continue;
+		else if(kbd_skip)
+		{
+			// Its 14 and 77 are not Ctrl and Num Lock
+			kbd_skip--;
+			kbd_status &= ~(KBD_BREAK | KBD_EX);
+		}
+		else
+		{
+#ifdef KBD_SET3
+			if(kbd_set3 == KBD_SET3_ON)
+			{
+				if((c = kbd_do_lookup(kbd_set3_ex, sc)))
+				{
+					sc = c;
+					kbd_status |= KBD_EX;
+				} else if((c = kbd_do_lookup(kbd_set3_lut, sc)))
+					sc = c;
+			}
+#endif
+			
+			flags = (kbd_status & KBD_EX) ? KEV_EXT : 0;
+			c = 0;
+			
+			if(kbd_status & KBD_BREAK)
+			{
+				flags |= KEV_BREAK;
+				
+				if(sc == 0x12 || sc == 0x59)	// Shift
+					kbd_status &= ~KBD_SHIFT;
+				else if(sc == 0x14)		// Ctrl
+					kbd_status &= ~KBD_CTRL;
+				else if(sc == 0x11)		// Alt
+					kbd_status &= ~(KBD_ALT | KBD_ALTGR);
+				else if(sc == 0x77 || sc == 0x58 || sc == 0x7e)	// Caps lock, num lock or scroll lock
+					kbd_status &= ~KBD_LOCKED;
+			} else if(kbd_status & KBD_EX)
+			{
+				if(sc == 0x14)			// R ctrl
+					kbd_status |= KBD_CTRL;
+				else if(sc == 0x11)		// R alt, AltGr on international layouts
+					kbd_status |= KBD_ALT | KBD_ALTGR;
+				else if(!kbd_raw)
+					c = kbd_do_lookup(kbd_table(KMAP_EXTENDED), sc);
+			} else
+			{
+				if(sc == 0x12 || sc == 0x59)	// Shift
+					kbd_status |= KBD_SHIFT;
+				else if(sc == 0x14)		// L ctrl
+					kbd_status |= KBD_CTRL;
+				else if(sc == 0x11)		// L alt
+					kbd_status |= KBD_ALT;
+				else if(sc == 0x77 || sc == 0x58 || sc == 0x7e)	// Num lock, caps lock or scroll lock
+				{
+					kbd_status &= ~(KBD_BREAK | KBD_EX);
+					if(kbd_status & KBD_LOCKED)
+						continue;		// Held down, no repeats
+					
+					if(sc == 0x77)
+						kbd_status ^= KBD_NUMLOCK;
+					else if(sc == 0x58)
+						kbd_status ^= KBD_CAPS;
+					else
+						kbd_status ^= KBD_SCROLL;
+					kbd_status |= KBD_LOCKED;
+					kbd_update_leds();
+				} else if(!kbd_raw)
+				{
+					if(kbd_status & KBD_ALTGR)
+						c = kbd_do_lookup(kbd_table(KMAP_ALTGR), sc);
+					if(!c && (kbd_status & KBD_NUMLOCK))
+						c = kbd_do_lookup(kbd_table(KMAP_KEYPAD), sc);
+					if(!c && sc < KMAP_SIZE)
+					{
+						// CAPS LOCK inverts SHIFT, but only for letters
+						
+						shift = kbd_status & KBD_SHIFT;
+						if((kbd_status & KBD_CAPS) && (pgm_read_byte(&kbd_table(KMAP_CAPS)[sc >> 3]) & _BV(sc & 7)))
+							shift = !shift;
+						
+						if(!shift || !(c = pgm_read_byte(&kbd_table(KMAP_SHIFT)[sc])))
+							c = pgm_read_byte(&kbd_table(KMAP_NORMAL)[sc]);
+					}
+				}
+			}
+			
+			kbd_status &= ~(KBD_BREAK | KBD_EX);
+			kbd_ev_put(sc, flags, c);
+		}
+	}
+}
+
+
+uint8_t kbd_events(void)
+{
+	kbd_send_next();
+	
+	if(kbd_status & KBD_RESEND)
+	{
+		kbd_status &= ~KBD_RESEND;
+		kbd_send(0xfe);
+	}
+	
+	kbd_decode();
+	
+	return kbd_evn;
+}
+
+
+uint8_t kbd_get_event(kbd_event_t *ev)
+{
+	if(!kbd_events())
+		return 0;
+	
+	*ev = kbd_evq[kbd_ev_tail];
+	kbd_ev_tail = (kbd_ev_tail + 1) & (KBD_EVSIZE - 1);
+	kbd_evn--;
+	
+	return 1;
+}
+
+
+unsigned char kbd_getchar(void)
+{
+	kbd_event_t	ev;
+	unsigned char	c;
+	
+	if(kbd_seq)					// Finish a sequence first
+	{
+		if((c = pgm_read_byte(kbd_seq++)))
+			return c;
+		kbd_seq = 0;
+	}
+	
+	while(kbd_get_event(&ev))
+	{
+		if((ev.flags & KEV_BREAK) || !ev.c)
+			continue;
+		
+		if((kbd_seq = kbd_sequence(ev.c)))
+			return pgm_read_byte(kbd_seq++);
+		return ev.c;
+	}
+	
+	return 0;
+}
+
+
+uint16_t kbd_get_status(void)
+{
+	return kbd_status;
+}
+
+
+void kbd_set_raw(uint8_t raw)
+{
+	kbd_raw = raw;
+}
+
+
+// Abandon the current frame and get ready for a new start bit. Called from
+// interrupt context only.
+
+static void kbd_frame_error(void)
+{
+	KBD_TIMEOUT_DISARM();
+	
+	if(kbd_status & KBD_SEND)
+	{
+		KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);	// Let go of the data line
+		kbd_status &= ~KBD_SEND;
+		KBD_USI_RX();
+	}
+#ifdef KBD_RESEND_ON_ERROR
+	else
+		kbd_status |= KBD_RESEND;
+#endif
+	
+	kbd_buffer = 0;
+	kbd_bit_n = 0;
+	kbd_n_bits = 0;
+}
+
+
+void kbd_tick(void)
+{
+	// No clock edge for too long: we missed one, so resync on the next start bit
+	
+	if(kbd_timeout && !--kbd_timeout)
+	{
+		// A frame cut short is an error, the quiet line after a bad start
+		// bit just ends the resync
+		
+		if(kbd_bit_n)
+		{
+			kbd_frame_error();
+			kbd_errors++;
+		}
+		kbd_bit_n = 1;
+#ifdef KBD_USI
+		KBD_USI_RESET();
+#endif
+	}
+#ifdef KBD_USI
+	
+	// A stray edge leaves the USI counter out of step with the frames, and no overflow
+	// comes to arm the timeout. A real frame overflows well within the timeout.
+	
+	if(!kbd_timeout && (USISR & 0x0f) && !(kbd_status & (KBD_SEND | KBD_RTS)))
+		KBD_TIMEOUT_ARM();
+#endif
+}
+
+
+// A good frame in: queue the scancode. Called from interrupt context only.
+
+static void kbd_frame_done(uint8_t c)
+{
+	KBD_TIMEOUT_DISARM();
+	TRACE_EVENT(TR_KBD_FRAME);
+	LAT_FRAME();
+	REC_EVENT(REC_KBD, c);
+	if(kbd_kbd_queue_scancode(c))
+		kbd_frames++;
+	else
+		kbd_overflows++;
+}
+
+
+ISR(KBD_INT)
+{
+	KBD_TIMEOUT_ARM();
+	
+	if(kbd_status & KBD_SEND)
+	{
+		// Send data
+		
+		if(kbd_bit_n == 9)				// Parity bit
+		{
+			if(kbd_n_bits & 0x01)
+				KBD_DATA_DDR |= _BV(KBD_DATA_BIT);
+			else
+				KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);
+		} else if(kbd_bit_n == 10)			// Stop bit
+			KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);
+		else if(kbd_bit_n == 11)			// ACK bit, set by device
+		{
+			KBD_TIMEOUT_DISARM();
+			kbd_buffer = 0;
+			kbd_bit_n = 0;
+			kbd_n_bits = 0;
+			kbd_status &= ~KBD_SEND;
+			KBD_USI_RX();
+		} else					// Data bits
+		{
+			if(kbd_buffer & (1 << (kbd_bit_n - 1)))
+			{
+				KBD_DATA_DDR &= ~_BV(KBD_DATA_BIT);
+				kbd_n_bits++;
+			} else
+				KBD_DATA_DDR |= _BV(KBD_DATA_BIT);
+		}
+	}
+#ifndef KBD_USI
+	else
+	{
+		// Receive data
+		
+		if(kbd_bit_n == 1)				// Start bit, must be low
+		{
+			if(!bit_is_clear(KBD_DATA_PIN, KBD_DATA_BIT))
+			{
+				kbd_frame_error();
+				kbd_errors++;
+			}
+		} else if(kbd_bit_n < 11)			// Data bits and parity, count the ones
+		{
+			if(!bit_is_clear(KBD_DATA_PIN, KBD_DATA_BIT))
+			{
+				if(kbd_bit_n < 10)
+					kbd_buffer |= (1 << (kbd_bit_n - 2));
+				kbd_n_bits++;
+			}
+		} else if(kbd_bit_n == 11)			// Stop bit, must be high
+		{
+			if(bit_is_clear(KBD_DATA_PIN, KBD_DATA_BIT))
+			{
+				kbd_frame_error();
+				kbd_errors++;
+			} else if(!(kbd_n_bits & 0x01))		// Odd parity
+			{
+				kbd_frame_error();
+				kbd_parity_errors++;
+			} else
+			{
+				kbd_frame_done(kbd_buffer);
+				kbd_buffer = 0;
+				kbd_bit_n = 0;
+				kbd_n_bits = 0;
+			}
+		}
+	}
+#endif
+	
+	kbd_bit_n++;
+	
+	KBD_SET_INT();
+}
+
+
+#ifdef KBD_USI
+static const uint8_t kbd_rev4[16] PROGMEM = {
+	0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
+};
+
+// USI counter overflow, twice per frame. kbd_bit_n is 1 while waiting for the start
+// bit and d0-d6, 9 for d7, parity and stop, 0 after a bad start bit until the line
+// has been quiet for the timeout (see kbd_tick). The timeout only runs while a frame
+// is coming in or during that resync, never for our own frames.
+
+ISR(HAL_USI_OVF_vect)
+{
+	uint8_t	c;
+	uint8_t	w;
+	uint8_t	p;
+	
+	c = USIBR;
+	
+	if(kbd_status & (KBD_SEND | KBD_RTS))
+	{
+		USISR = _BV(USIOIF);			// Our own frame
+		return;
+	}
+	
+	if(kbd_bit_n == 1)
+	{
+		// An edge may have passed already, keep it in the count
+		
+		USISR = _BV(USIOIF) | (KBD_USI_TAIL + (USISR & 0x0f));
+		
+		if(c & 0x80)				// Start bit, must be low
+		{
+			kbd_frame_error();
+			kbd_errors++;
+		} else
+		{
+			kbd_buffer = c;			// d0 in bit 6 down to d6 in bit 0
+			kbd_bit_n = 9;
+		}
+		KBD_TIMEOUT_ARM();
+		return;
+	}
+	
+	USISR = _BV(USIOIF);
+	
+	if(kbd_bit_n != 9)
+	{
+		KBD_TIMEOUT_ARM();			// Resyncing, wait for a quiet line
+		return;
+	}
+	
+	// d7 in bit 2, parity in bit 1, stop in bit 0
+	
+	w = (kbd_buffer << 1) | ((c >> 2) & 0x01);	// Data bit reversed
+	
+	if(!(c & 0x01))					// Stop bit, must be high
+	{
+		// The counter ran the length of a frame, so it is still in step and
+		// the next frame is taken as it comes
+		
+		kbd_frame_error();
+		kbd_errors++;
+		kbd_bit_n = 1;
+		return;
+	}
+	
+	p = w ^ (w >> 4);
+	p ^= p >> 2;
+	p ^= p >> 1;
+	
+	if(!((p ^ (c >> 1)) & 0x01))			// Odd parity
+	{
+		kbd_frame_error();
+		kbd_parity_errors++;
+		kbd_bit_n = 1;				// Still in step
+	} else
+	{
+		kbd_bit_n = 1;
+		kbd_frame_done((pgm_read_byte(&kbd_rev4[w & 0x0f]) << 4) | pgm_read_byte(&kbd_rev4[w >> 4]));
+	}
+}
+#endif
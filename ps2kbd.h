@@ -1,76 +1,211 @@
-/* PS/2 keyboard routines by Jurre Hanema, version 1.0
- * ps2kbd.h
- *
- * Features yet to be implemented:
- *	- Support for PAUSE/BREAK and PRINT SCREEN/SYSRQ
- *
- * Released under "THE BEER-WARE LICENSE" (Revision 42):
- * <kipmans@gmail.com> wrote this file. As long as you retain this notice you can 
- * do whatever you want with this stuff. If we meet some day, and you think this 
- * stuff is worth it, you can buy me a beer in return.
- */
-
-#ifndef __PS2KBD_H__
-#define __PS2KBD_H__
-
-#include <stdint.h>
-
-
-#define	KBD_INT		INT1_vect		/* Interrupt to be activated on negative edge of clock signal */
-#define	KBD_SET_INT()	MCUCR |= _BV(ISC11)	/* Code to trigger the appropriate interrupt on the negative edge */
-#define KBD_EN_INT()	GIMSK |= _BV(INT1)	/* Code to enable the appropriate interrupt */
-//#define KBD_EN_INT()	GICR |= _BV(INT1)	/* Code to enable the appropriate interrupt */
-
-#define	KBD_DATA_PORT	PORTD
-#define	KBD_DATA_DDR	DDRD
-#define	KBD_DATA_PIN	PIND
-#define	KBD_DATA_BIT	PD4
-
-#define	KBD_CLOCK_PORT	PORTD
-#define	KBD_CLOCK_DDR	DDRD
-#define	KBD_CLOCK_BIT	PD3
-
-#define	KBD_BUFSIZE	8
-
-// Bits in keyboard status register
-
-
-#define	KBD_SHIFT	1			/* SHIFT is held down */
-#define	KBD_CTRL	2			/* CTRL is held down */
-#define KBD_ALT		4			/* ALT is held down */
-#define	KBD_NUMLOCK	8			/* NUM LOCK is activated */
-#define	KBD_CAPS	16			/* CAPS LOCK is activated */
-#define	KBD_SCROLL	32			/* SCROLL LOCK is activated */
-#define	KBD_BAT_PASSED	1024			/* Keyboard passed its BAT test */
-
-#define	KBD_SEND	64			/* This and the next bits are for internal use */
-#define	KBD_EX		128
-#define	KBD_BREAK	256
-#define	KBD_LOCKED	512
-
-
-// "Public" function declarations
-
-// Initialize keyboard routines: activate appropriate interrupts. This also executes a 
-// sei() to enable them.
-// NOTE: sei() disabled
-
-void kbd_init(void);
-
-// Returns the next character waiting in the buffer or 0 if there are no characters
-// left.
-
-unsigned char kbd_getchar(void);
-
-// Sends data to the keyboard
-// If another sending cycle is in progress this function waits (blocks) for 5 ms and then
-// tries again.
-
-void kbd_send(uint8_t data);
-
-// Returns the value of the keyboard status register. Can be used to check if SHIFT,
-// CAPS LOCK or NUM LOCK is activated.
-
-uint16_t kbd_get_status(void);
-
-#endif	// __PS2KBD_H__
+/* PS/2 keyboard routines by Jurre Hanema, version 1.0
+ * ps2kbd.h
+ *
+ * Features yet to be implemented:
+ *	- Support for PAUSE/BREAK and PRINT SCREEN/SYSRQ
+ *
+ * Released under "THE BEER-WARE LICENSE" (Revision 42):
+ * <kipmans@gmail.com> wrote this file. As long as you retain this notice you can 
+ * do whatever you want with this stuff. If we meet some day, and you think this 
+ * stuff is worth it, you can buy me a beer in return.
+ */
+
+#ifndef __PS2KBD_H__
+#define __PS2KBD_H__
+
+#include <stdint.h>
+
+#include "hal.h"
+
+
+#define	KBD_INT		HAL_INT1_vect		/* Interrupt to be activated on negative edge of clock signal */
+#define	KBD_SET_INT()	HAL_EICR |= _BV(HAL_ISC11)	/* Code to trigger the appropriate interrupt on the negative edge */
+#define KBD_EN_INT()	HAL_EIMSK |= _BV(HAL_INT1)	/* Code to enable the appropriate interrupt */
+
+#define	KBD_DATA_PORT	PORTD
+#define	KBD_DATA_DDR	DDRD
+#define	KBD_DATA_PIN	PIND
+#define	KBD_DATA_BIT	PD4
+
+#define	KBD_CLOCK_PORT	PORTD
+#define	KBD_CLOCK_DDR	DDRD
+#define	KBD_CLOCK_BIT	PD3
+
+// USI receiver (board option KBD_USI, see hal_t4313.h). The USI counts both clock
+// edges and samples DI on the falling ones, so it overflows once after the start bit
+// and d0-d6 and once more, reloaded to 10, after d7, parity and stop. INT1 is only
+// enabled while sending.
+
+#ifdef KBD_USI
+#ifndef HAL_USI_OVF_vect
+#error "KBD_USI needs a part with a USI, see hal_t4313.h"
+#endif
+#define	KBD_USI_ON()	USICR = _BV(USIOIE) | _BV(USIWM0) | _BV(USICS1) | _BV(USICS0)
+#define	KBD_USI_RESET()	USISR = _BV(USIOIF)		/* Counter to 0, wait for a start bit */
+#define	KBD_USI_TAIL	10				/* Counter reload for the last 3 bits */
+#define	KBD_USI_RX()	do { HAL_EIMSK &= ~_BV(HAL_INT1); KBD_USI_RESET(); } while(0)	/* Sending done */
+#else
+#define	KBD_USI_RX()
+#endif
+
+#ifndef KBD_BUFSIZE
+#define	KBD_BUFSIZE	8			/* Scancode ring, a power of 2; board profiles raise it */
+#endif
+
+#define	KBD_TXSIZE	4			/* Bytes waiting to be sent to the keyboard */
+
+#ifndef KBD_EVSIZE
+#define	KBD_EVSIZE	4			/* Decoded key events waiting, a power of 2 */
+#endif
+
+// Switch the keyboard to scancode set 3 after power-up or a reset, with every key
+// make-only except the modifiers and locks. A key press is then one byte instead of
+// three to five, but there's no auto-repeat. Keyboards that don't answer 3 to the
+// F0 00 query stay in set 2. Set 3 codes are translated to set 2 ones, so the same
+// keymaps work.
+
+//#define	KBD_SET3
+
+#define	KBD_SET3_OFF	0			/* Set 2 */
+#define	KBD_SET3_PROBE	1			/* Waiting for the answer to F0 00 */
+#define	KBD_SET3_ON	2
+
+// Inter-bit timeout. The countdown is restarted on every clock edge and run by the
+// millisecond tick (see sched.h); if the next edge doesn't arrive within 2-3 ms the
+// frame is abandoned and the receiver resyncs.
+
+#define	KBD_TIMEOUT_MS		2
+#define	KBD_TIMEOUT_ARM()	kbd_timeout = KBD_TIMEOUT_MS + 1
+#define	KBD_TIMEOUT_DISARM()	kbd_timeout = 0
+
+// Ask the keyboard to resend (0xFE) after a framing or parity error. Comment out to just
+// drop the damaged byte.
+
+#define	KBD_RESEND_ON_ERROR
+
+// Key events from kbd_get_event(). code is the set 2 scancode (set 3 codes are
+// translated), flags has the modifiers held once the key was applied, plus
+// KEV_EXT for e0 prefixed keys and KEV_BREAK for a release. c is what the keymap
+// gives for a make, 0 for modifiers, locks, releases and unmapped keys, and always
+// 0 with kbd_set_raw(). Codes KMAP_SEQ_BASE and up stand for a sequence, see
+// kbd_sequence(). With KBD_EVTIME t is sched_ms when the last byte of the key came
+// in, taken in the receive interrupt so a busy main loop doesn't delay it, for the
+// raw key mode (see ps2_term.h). It costs two bytes of RAM per event and per
+// kbd_queue entry, the mega profiles turn it on.
+
+//#define	KBD_EVTIME
+
+#define	KEV_SHIFT	1			/* Same bits as KBD_SHIFT, KBD_CTRL, KBD_ALT */
+#define	KEV_CTRL	2
+#define	KEV_ALT		4
+#define	KEV_ALTGR	8
+#define	KEV_EXT		64
+#define	KEV_BREAK	128
+
+typedef struct
+{
+	uint8_t		code;
+	uint8_t		flags;
+	unsigned char	c;
+#ifdef KBD_EVTIME
+	uint16_t	t;
+#endif
+} kbd_event_t;
+
+// Bits in keyboard status register
+
+
+#define	KBD_SHIFT	1			/* SHIFT is held down */
+#define	KBD_CTRL	2			/* CTRL is held down */
+#define KBD_ALT		4			/* ALT is held down */
+#define	KBD_NUMLOCK	8			/* NUM LOCK is activated */
+#define	KBD_CAPS	16			/* CAPS LOCK is activated */
+#define	KBD_SCROLL	32			/* SCROLL LOCK is activated */
+#define	KBD_BAT_PASSED	1024			/* Keyboard passed its BAT test */
+
+#define	KBD_SEND	64			/* This and the next bits are for internal use */
+#define	KBD_EX		128
+#define	KBD_BREAK	256
+#define	KBD_LOCKED	512
+#define	KBD_RESEND	2048			/* Framing error seen, resend requested */
+#define	KBD_ALTGR	4096			/* Right ALT (AltGr) is held down */
+#define	KBD_RTS		8192			/* Clock held low before sending */
+
+
+// "Public" function declarations
+
+// Initialize keyboard routines: activate appropriate interrupts. This also executes a 
+// sei() to enable them.
+// NOTE: sei() disabled
+
+void kbd_init(void);
+
+// Returns the next character waiting in the buffer or 0 if there are no characters
+// left. Cursor, editing and function keys produce VT100 sequences, which are
+// returned one byte per call. Built on kbd_get_event(); releases and the Ctrl and
+// Alt state are dropped.
+
+unsigned char kbd_getchar(void);
+
+// Takes the next key event into ev and returns 1, or returns 0 if there is none.
+// Don't mix with kbd_getchar(), which takes events itself.
+
+uint8_t kbd_get_event(kbd_event_t *ev);
+
+// Decodes what has come in and returns the number of events waiting, at most
+// KBD_EVSIZE. That many kbd_get_event() calls will succeed.
+
+uint8_t kbd_events(void);
+
+// Returns the PROGMEM string for a sequence code from a key event (NUL
+// terminated), or 0 if the code is a plain character.
+
+const unsigned char *kbd_sequence(unsigned char c);
+
+// Queues data to be sent to the keyboard and returns straight away. Each byte goes out
+// once the previous one is done, driven from kbd_events(). Returns 0 and drops the byte
+// if KBD_TXSIZE bytes are already waiting.
+
+uint8_t kbd_send(uint8_t data);
+
+// Queues a scancode as if it had been received, returns 0 if kbd_queue is full.
+// Interrupts must be off.
+
+uint8_t kbd_kbd_queue_scancode(volatile uint8_t p);
+
+// Runs the inter-bit timeout, called from the millisecond tick ISR
+
+void kbd_tick(void);
+
+// Returns the value of the keyboard status register. Can be used to check if SHIFT,
+// CAPS LOCK or NUM LOCK is activated.
+
+uint16_t kbd_get_status(void);
+
+// With raw set the decoder skips the keymap lookups and events carry c = 0, for
+// hosts that take scancodes (see ps2_term.h). Modifiers and locks are still
+// tracked. kbd_getchar() gets nothing while raw is set.
+
+void kbd_set_raw(uint8_t raw);
+
+// Receiver statistics, updated from the ISRs. They count since power-up and
+// simply wrap.
+
+extern volatile uint16_t	kbd_frames;		/* Bytes received from the keyboard */
+extern volatile uint8_t		kbd_errors;		/* Framing errors: timeouts, bad start or stop bits */
+extern volatile uint8_t		kbd_parity_errors;	/* Bytes with bad parity */
+extern volatile uint8_t		kbd_overflows;		/* Bytes lost because kbd_queue was full */
+
+extern volatile uint8_t		kbd_timeout;		/* Inter-bit timeout countdown in ms, 0 when idle */
+
+#ifdef KBD_SET3
+extern uint8_t			kbd_set3;		/* KBD_SET3_OFF, _PROBE or _ON */
+#endif
+
+// Selects the keyboard layout (KMAP_US, KMAP_UK, ... in the order given by
+// KEYMAP in the Makefile) and stores it in EEPROM. Does nothing if only one
+// layout is compiled in.
+
+void kbd_set_layout(uint8_t layout);
+
+#endif	// __PS2KBD_H__
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+#
+# ramcheck.py - Static RAM budget for ps2_term. Lists the RAM each module
+# takes for its variables, estimates the deepest stack each entry point
+# (main and every ISR) can reach from the -fstack-usage (.su) files and
+# the call graph in the linked ELF, and fails if the variables plus main's
+# stack plus the deepest ISR don't fit in the MCU's RAM. ISRs don't nest
+# here, none of them is ISR_NOBLOCK.
+#
+# usage: python3 ramcheck.py mcu target.elf module.o ...
+#
+# Calls through pointers (the scheduler's task and timer tables) are taken
+# to reach any function whose address is taken somewhere, found from the
+# pm()/gs() relocations in the objects. Recursion can't be bounded and
+# fails the check.
+#
+# (C) 2012 KB4OID Labs, a division of Kodetroll Heavy Industries.
+#
+
+import os
+import re
+import subprocess
+import sys
+
+RAM = {'attiny4313': 256, 'atmega328p': 2048, 'atmega1284p': 16384}
+
+RET_ADDR = 2		# bytes a call pushes, all profiles have 16 bit PCs
+
+
+def tool(name, *args):
+	return subprocess.run(['avr-' + name] + list(args), check=True,
+		stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+
+def module_ram(obj):
+	n = 0
+	for line in tool('nm', '-S', obj).splitlines():
+		f = line.split()
+		if len(f) == 4 and f[2] in 'bBdDC':
+			n += int(f[1], 16)
+	return n
+
+
+def elf_ram(elf):
+	n = 0
+	for line in tool('size', '-A', elf).splitlines():
+		f = line.split()
+		if len(f) == 3 and f[0] in ('.data', '.bss', '.noinit'):
+			n += int(f[1])
+	return n
+
+
+def frames(objs):
+	fr = {}
+	for obj in objs:
+		su = os.path.splitext(obj)[0] + '.su'
+		if not os.path.exists(su):
+			continue
+		with open(su) as f:
+			for line in f:
+				where, size, kind = line.rstrip('\n').split('\t')
+				name = where.split(':')[-1]
+				if kind != 'static':
+					print('ramcheck: %s has a %s stack frame' % (name, kind))
+				fr[name] = int(size)
+	return fr
+
+
+def functions(obj):
+	# section -> {offset: name} for the functions defined in an object
+	fn = {}
+	for line in tool('objdump', '-t', obj).splitlines():
+		m = re.match(r'^([0-9a-f]+)\s.*\sF\s+(\S+)\s+[0-9a-f]+\s+(\S+)$', line)
+		if m:
+			fn.setdefault(m.group(2), {})[int(m.group(1), 16)] = m.group(3)
+	return fn
+
+
+def address_taken(objs):
+	# Functions an icall can reach: the ones whose word address is loaded
+	# (gs(), pm()) or stored in a table (R_AVR_16_PM). A static function
+	# may show up as its section plus an offset.
+	taken = set()
+	for obj in objs:
+		fn = functions(obj)
+		for line in tool('objdump', '-r', obj).splitlines():
+			m = re.match(r'^[0-9a-f]+\s+(R_AVR_\S+)\s+(\S+)$', line)
+			if not m or not re.search(r'_(PM|GS)', m.group(1)):
+				continue
+			sym, _, off = m.group(2).partition('+')
+			off = int(off, 16) if off else 0
+			if not sym.startswith('.') and not off:
+				taken.add(sym)		# may be in another module
+			elif off in fn.get(sym, {}):
+				taken.add(fn[sym][off])
+			else:
+				sys.exit('ramcheck: %s: can\'t tell which function %s is' %
+					(os.path.basename(obj), m.group(2)))
+	return taken
+
+
+def call_graph(elf, indirect):
+	calls = {}
+	cur = None
+	for line in tool('objdump', '-d', elf).splitlines():
+		m = re.match(r'^[0-9a-f]+ <([^>]+)>:$', line)
+		if m:
+			cur = m.group(1)
+			calls[cur] = set()
+			continue
+		if cur is None:
+			continue
+		if re.search(r'\sicall\b', line):
+			calls[cur].update(('call', t) for t in indirect)
+			continue
+		m = re.search(r'\s(r?call|r?jmp)\s.*<([^>+]+)>', line)
+		if m and m.group(2) != cur:
+			calls[cur].add(('call' if m.group(1).endswith('call') else 'jmp', m.group(2)))
+	return calls
+
+
+def depth(name, calls, fr, path):
+	if name in path:
+		sys.exit('ramcheck: recursion through %s' % ' -> '.join(path + [name]))
+	worst = 0
+	for kind, to in calls.get(name, ()):
+		if to not in calls:
+			continue
+		d = depth(to, calls, fr, path + [name]) + (RET_ADDR if kind == 'call' else 0)
+		worst = max(worst, d)
+	return fr.get(name, 0) + worst
+
+
+def main(argv):
+	if len(argv) < 3 or argv[1] not in RAM:
+		sys.exit('usage: %s {%s} target.elf module.o ...' % (argv[0], '|'.join(RAM)))
+
+	ram = RAM[argv[1]]
+	elf = argv[2]
+	objs = argv[3:]
+
+	print('Static RAM by module:')
+	for obj in objs:
+		print('  %-16s %5d' % (os.path.basename(obj), module_ram(obj)))
+	static = elf_ram(elf)
+	print('  %-16s %5d  (with the C library)' % ('total', static))
+
+	fr = frames(objs)
+	indirect = address_taken(objs)
+	calls = call_graph(elf, indirect)
+	print('Reached through pointers: %s' % ' '.join(sorted(indirect)))
+	print('Worst case stack by entry point:')
+	main_depth = depth('main', calls, fr, [])
+	print('  %-16s %5d' % ('main', main_depth))
+	isr_depth = 0
+	for name in sorted(calls):
+		if re.match(r'^__vector_\d+$', name):
+			d = depth(name, calls, fr, []) + RET_ADDR
+			print('  %-16s %5d' % (name, d))
+			isr_depth = max(isr_depth, d)
+
+	total = static + main_depth + isr_depth
+	print('Budget: %d static + %d main + %d ISR = %d of %d bytes' %
+		(static, main_depth, isr_depth, total, ram))
+	if total > ram:
+		sys.exit('ramcheck: RAM budget exceeded by %d bytes' % (total - ram))
+
+
+if __name__ == '__main__':
+	main(sys.argv)
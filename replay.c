@@ -0,0 +1,178 @@
+/**************************************************************************
+ *
+ * REPLAY.C - Input capture and replay
+ * See replay.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "replay.h"
+#include "sched.h"
+#include "uart.h"
+#include "ps2kbd.h"
+#include "ps2_term.h"
+#include "latency.h"
+#include "ascii.h"
+
+#ifdef REPLAY
+
+volatile uint8_t rec_state = REC_IDLE;
+uint8_t rec_buf[REC_SIZE][2];
+volatile uint16_t rec_n = 0;		// entries in the capture
+volatile uint16_t rec_last = 0;		// sched_ms of the last entry recorded
+uint16_t rec_pos = 0;			// next entry to replay, or load
+uint16_t rec_due = 0;			// sched_ms it is due at
+uint8_t rec_nibbles = 0;		// hex digits loaded into the current entry
+
+// Adds an entry, called from the ISRs while recording
+void rec_event(uint8_t src, uint8_t c)
+{
+	uint16_t gap = sched_ms - rec_last;
+
+	if (rec_n == REC_SIZE)
+	{
+		rec_state = REC_IDLE;
+		return;
+	}
+
+	rec_last = sched_ms;
+	rec_buf[rec_n][0] = src | (gap > REC_GAP_MAX ? REC_GAP_MAX : gap);
+	rec_buf[rec_n][1] = c;
+	rec_n++;
+}
+
+// Clears the capture and starts recording
+void rec_start(void)
+{
+	cli();
+	rec_n = 0;
+	rec_last = sched_ms;
+	rec_state = REC_RECORD;
+	sei();
+}
+
+// Stops recording and sends the capture to the serial port
+void rec_dump(void)
+{
+	uint16_t i;
+
+	cli();
+	if (rec_state == REC_RECORD)
+	{
+		rec_state = REC_IDLE;
+
+		// The ESC 4 that stopped it is not part of the session
+		if (rec_n >= 2 && rec_buf[rec_n - 2][1] == ESC && !(rec_buf[rec_n - 2][0] & REC_KBD))
+			rec_n -= 2;
+	}
+	sei();
+
+	UART_putc('R');
+	for (i = 0; i < rec_n; i++)
+	{
+		UART_putc(' ');
+		UART_puthex(rec_buf[i][0]);
+		UART_puthex(rec_buf[i][1]);
+	}
+	UART_putc(CR);
+	UART_putc(LF);
+}
+
+// Feeds the entries that are due, then waits for the next one. Times are
+// kept from the start of the replay so the timer's 1 ms rounding doesn't
+// add up.
+static void rec_next(void)
+{
+	uint8_t h;
+	int16_t wait;
+
+	while (rec_state == REC_REPLAY && rec_pos < rec_n)
+	{
+		h = rec_buf[rec_pos][0];
+		wait = (int16_t)(rec_due + (h & REC_GAP_MAX) - sched_now());
+		if (wait > 0)
+		{
+			// Without a timer nothing would call us again, end the replay
+			if (!sched_after(wait, rec_next))
+				break;
+			return;
+		}
+
+		rec_due += h & REC_GAP_MAX;
+
+		cli();
+		if (h & REC_KBD)
+		{
+			LAT_FRAME();	// key latency from here, as for a real frame
+			if (kbd_kbd_queue_scancode(rec_buf[rec_pos][1]))
+				kbd_frames++;
+			else
+				kbd_overflows++;
+		}
+		else
+			rx_put(rec_buf[rec_pos][1]);
+		sei();
+
+		rec_pos++;
+	}
+
+	rec_state = REC_IDLE;
+}
+
+// Starts replaying the capture
+void rec_replay(void)
+{
+	rec_pos = 0;
+	rec_due = sched_now();
+	rec_state = REC_REPLAY;
+	rec_next();
+}
+
+// Clears the capture, the following serial bytes up to CR are loaded
+void rec_load_start(void)
+{
+	cli();
+	rec_n = 0;
+	rec_state = REC_LOAD;
+	sei();
+	rec_nibbles = 0;
+}
+
+// Takes one serial byte while loading
+void rec_load(unsigned char c)
+{
+	uint8_t *p;
+
+	if (c == CR)
+	{
+		rec_state = REC_IDLE;
+		return;
+	}
+
+	if (c >= '0' && c <= '9')
+		c -= '0';
+	else if (c >= 'A' && c <= 'F')
+		c -= 'A' - 10;
+	else if (c >= 'a' && c <= 'f')
+		c -= 'a' - 10;
+	else
+		return;
+
+	if (rec_n == REC_SIZE)
+		return;
+
+	p = &rec_buf[rec_n][rec_nibbles >> 1];
+	*p = (*p << 4) | c;
+	if (++rec_nibbles == 4)
+	{
+		rec_nibbles = 0;
+		rec_n++;
+	}
+}
+
+#endif
@@ -0,0 +1,76 @@
+/**************************************************************************
+ *
+ * REPLAY.H - Input capture and replay definitions
+ * Optional recording of the PS/2 and serial input streams with their
+ * timing, so that the same session can be fed through the firmware again
+ * and two builds compared on identical input.
+ *
+ * A capture is a list of two byte entries, header then data:
+ *
+ *   header bit 7     source: 1 PS/2 scancode, 0 serial byte
+ *   header bits 0-6  ms since the previous entry, 127 for 127 or more
+ *
+ * Scancodes are taken as they enter kbd_queue and serial bytes as they
+ * enter the RX ring, so a replay goes through the same decoding,
+ * display and TX paths, and the ESC 0 and ESC 2 counters. Idle gaps
+ * longer than 127 ms are shortened to 127 ms.
+ *
+ * Host commands:
+ *
+ *   ESC 3   start recording, clearing the capture
+ *   ESC 4   stop recording and send the capture as "R hhdd hhdd ..."
+ *   ESC 5   replay the capture
+ *   ESC 6   load a capture: hex digits up to the next CR, four per
+ *           entry, anything else skipped, so an "R ..." line from
+ *           ESC 4 (or one converted from a logic analyzer export)
+ *           can be sent back as is
+ *
+ * Recording stops when the capture is full, and during a replay.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdint.h>
+
+#include "hal.h"
+
+//#define REPLAY		/* compile capture and replay in, the mega profiles do */
+
+#ifndef REC_SIZE
+#define REC_SIZE	64	/* entries in the capture */
+#endif
+
+#define REC_KBD		0x80	/* header bit: PS/2 scancode */
+#define REC_GAP_MAX	0x7F
+
+#define REC_IDLE	0
+#define REC_RECORD	1
+#define REC_REPLAY	2
+#define REC_LOAD	3
+
+#ifdef REPLAY
+
+extern volatile uint8_t rec_state;
+
+void rec_event(uint8_t src, uint8_t c);
+void rec_start(void);
+void rec_dump(void);
+void rec_replay(void);
+void rec_load_start(void);
+void rec_load(unsigned char c);
+
+// In the ISRs, for each byte queued. src is REC_KBD or 0.
+#define REC_EVENT(src, c)	do { if (rec_state == REC_RECORD) rec_event(src, c); } while (0)
+
+#else
+
+#define REC_EVENT(src, c)
+
+#endif
+
+#endif //__REPLAY_H__
@@ -0,0 +1,151 @@
+/**************************************************************************
+ *
+ * SCHED.C - Millisecond tick and cooperative task scheduler
+ * See sched.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+
+#include "sched.h"
+#include "ps2kbd.h"
+#include "uart.h"
+
+volatile uint16_t sched_ms = 0;
+
+// Pending timeouts, a free slot has fn == 0
+uint16_t sched_due[SCHED_TIMERS];
+sched_fn_t sched_fn[SCHED_TIMERS];
+
+// Start Timer0 in CTC mode, one compare match per millisecond
+void sched_init(void)
+{
+	TCCR0A = _BV(WGM01);
+	OCR0A = SCHED_OCR;
+	TCCR0B = SCHED_CS;
+	HAL_TIFR0 = _BV(OCF0A);
+	HAL_TIMSK0 |= _BV(OCIE0A);
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+	sched_ms++;
+
+	// PS/2 inter-bit timeout
+	kbd_tick();
+
+#ifdef RS485
+	// bus turnaround after a poll
+	rs485_tick();
+#endif
+}
+
+// sched_ms is two bytes, so read it with the tick held off
+uint16_t sched_now(void)
+{
+	uint8_t sreg = SREG;
+	uint16_t t;
+
+	cli();
+	t = sched_ms;
+	SREG = sreg;
+
+	return t;
+}
+
+/*************************************************************************
+ * Arrange for fn to be called from the main loop after at least ms
+ * milliseconds. A function already pending is rescheduled rather than
+ * added twice.
+ *
+ * Input:    ms, fn
+ * Modifies: sched_due, sched_fn
+ * Returns:  0 if all SCHED_TIMERS slots are in use, 1 otherwise
+ *************************************************************************/
+
+uint8_t sched_after(uint16_t ms, sched_fn_t fn)
+{
+	uint8_t i;
+	uint8_t slot = SCHED_TIMERS;
+
+	for (i = 0; i < SCHED_TIMERS; i++)
+	{
+		if (sched_fn[i] == fn)
+		{
+			slot = i;
+			break;
+		}
+		if (!sched_fn[i])
+			slot = i;
+	}
+	if (slot == SCHED_TIMERS)
+		return 0;
+
+	// +1 because the first tick may come straight away
+	sched_due[slot] = sched_now() + ms + 1;
+	sched_fn[slot] = fn;
+
+	return 1;
+}
+
+// Call the timeouts that have expired
+static void sched_timers(void)
+{
+	uint8_t i;
+	uint16_t now = sched_now();
+	sched_fn_t fn;
+
+	for (i = 0; i < SCHED_TIMERS; i++)
+	{
+		fn = sched_fn[i];
+		if (fn && (int16_t)(now - sched_due[i]) >= 0)
+		{
+			// free the slot first, fn may reschedule itself
+			sched_fn[i] = 0;
+			fn();
+		}
+	}
+}
+
+/*************************************************************************
+ * The main loop. Runs the expired timeouts, then the first task in the
+ * list that has work, and starts over.
+ *
+ * Input:    PROGMEM table of tasks in priority order, and their number
+ * Modifies: nothing itself
+ * Returns:  never
+ *************************************************************************/
+
+void sched_run(const sched_task_t *tasks, uint8_t n)
+{
+	uint8_t i;
+	uint8_t kicked = 0;
+	sched_task_t task;
+
+	while (1)
+	{
+		// Kick the watchdog once per tick, so it sees the tick ISR and
+		// this loop both making progress
+		if ((uint8_t)sched_ms != kicked)
+		{
+			kicked = sched_ms;
+			wdt_reset();
+		}
+
+		sched_timers();
+
+		for (i = 0; i < n; i++)
+		{
+			task = (sched_task_t)pgm_read_word(&tasks[i]);
+			if (task())
+				break;
+		}
+	}
+}
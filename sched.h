@@ -0,0 +1,63 @@
+/**************************************************************************
+ *
+ * SCHED.H - Millisecond tick and cooperative task scheduler definitions
+ * Timer0 runs in CTC mode and interrupts once a millisecond. The tick
+ * ISR counts sched_ms and runs the PS/2 inter-bit timeout (kbd_tick)
+ * and, with RS485, the bus turnaround (rs485_tick).
+ *
+ * The main loop is sched_run(), which never returns. It takes a PROGMEM
+ * table of tasks in priority order. A task does a bounded amount of work and
+ * returns non-zero if it did any. After a busy task the list is scanned
+ * from the top again, so a flood on a low priority path can't hold up a
+ * higher one for more than one task call.
+ *
+ * sched_after() is the timeout service: it calls a function from the
+ * main loop once at least ms milliseconds have passed. Use it instead of
+ * _delay_ms(); the other tasks keep running while it waits.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdint.h>
+
+#include <avr/io.h>
+#include "hal.h"
+
+// pending sched_after() calls: show_terminal and kbd_rts_done, and rec_next
+// while a capture is replayed
+#ifdef REPLAY
+#define SCHED_TIMERS	3
+#else
+#define SCHED_TIMERS	2
+#endif
+
+// Timer0 runs at F_CPU/64, or F_CPU/256 when that doesn't fit 8 bits
+#if F_CPU / 64 / 1000 <= 256
+#define SCHED_PRESCALE	64
+#define SCHED_CS	(_BV(CS01) | _BV(CS00))
+#else
+#define SCHED_PRESCALE	256
+#define SCHED_CS	_BV(CS02)
+#endif
+#define SCHED_OCR	((F_CPU / SCHED_PRESCALE + 500) / 1000 - 1)
+
+#if SCHED_OCR > 255
+#error "F_CPU too high for the Timer0 millisecond tick"
+#endif
+
+typedef uint8_t (*sched_task_t)(void);
+typedef void (*sched_fn_t)(void);
+
+extern volatile uint16_t sched_ms;	/* milliseconds since sched_init(), wraps */
+
+void sched_init(void);
+uint16_t sched_now(void);
+uint8_t sched_after(uint16_t ms, sched_fn_t fn);
+void sched_run(const sched_task_t *tasks, uint8_t n);
+
+#endif //__SCHED_H__
@@ -0,0 +1,170 @@
+/**************************************************************************
+ *
+ * SCREEN.C - Framed binary screen update protocol
+ * See screen.h for the frame format. Bytes are fed in from process_char()
+ * one at a time, so this runs in task_rx.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include "screen.h"
+#include "clock.h"
+#include "uart.h"
+#include "ascii.h"
+
+#ifdef SCREEN_PROTO
+
+// Receiver states
+#define SCR_IDLE	0
+#define SCR_OP		1
+#define SCR_LEN		2
+#define SCR_PAYLOAD	3
+#define SCR_CRC		4
+#define SCR_SKIP	5	/* rest of a frame too long to take */
+
+uint8_t scr_state = SCR_IDLE;
+uint8_t scr_op;
+uint8_t scr_len;
+uint8_t scr_n;
+uint8_t scr_crc;
+uint16_t scr_last;
+uint8_t scr_buf[SCREEN_MAX_PAYLOAD];
+
+// Update a CRC-8 (poly x^8 + x^2 + x + 1) with one byte
+uint8_t crc8(uint8_t crc, uint8_t c)
+{
+	uint8_t i;
+
+	crc ^= c;
+	for (i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+
+	return crc;
+}
+
+// Apply a frame that passed the CRC check. Returns 0 if the opcode or
+// arguments are bad, in which case nothing has been changed.
+uint8_t screen_apply(void)
+{
+	uint8_t row = scr_buf[0];
+	uint8_t col = scr_buf[1];
+	uint8_t w, h, ch;
+	uint8_t x;
+
+	if (scr_len < 2 || row >= LCD_LINES || col >= LCD_DISP_LENGTH)
+		return 0;
+
+	switch (scr_op)
+	{
+		case SCR_WRITE:
+			w = scr_len - 2;
+			if (col + w > LCD_DISP_LENGTH)
+				return 0;
+			for (x = 0; x < w; x++)
+				lcd_putc_at(col + x, row, scr_buf[2 + x]);
+			break;
+
+		case SCR_FILL:
+		case SCR_CLEAR:
+			if (scr_len != 4)
+				return 0;
+			w = scr_buf[2];
+			if (scr_op == SCR_FILL)
+			{
+				h = 1;
+				ch = scr_buf[3];
+			}
+			else
+			{
+				h = scr_buf[3];
+				ch = ' ';
+			}
+			if (col + w > LCD_DISP_LENGTH || row + h > LCD_LINES)
+				return 0;
+			lcd_fill(col, row, w, h, ch);
+			break;
+
+		case SCR_GOTO:
+			if (scr_len != 2)
+				return 0;
+			lcd_gotoxy(col, row);
+			break;
+
+		default:
+			return 0;
+	}
+
+	return 1;
+}
+
+
+// Feed one received byte to the frame receiver. Returns 1 if the byte was
+// part of a frame, 0 if it should be processed as a normal character.
+uint8_t screen_rx(uint8_t c)
+{
+	uint16_t now = clock_now();
+
+	// Give up on a frame if the host went quiet half way through
+	if (scr_state != SCR_IDLE && (uint16_t)(now - scr_last) > SCREEN_TIMEOUT)
+		scr_state = SCR_IDLE;
+	scr_last = now;
+
+	switch (scr_state)
+	{
+		case SCR_IDLE:
+			if (c != DLE)
+				return 0;
+			scr_crc = 0;
+			scr_state = SCR_OP;
+			break;
+
+		case SCR_OP:
+			scr_op = c;
+			scr_crc = crc8(scr_crc, c);
+			scr_state = SCR_LEN;
+			break;
+
+		case SCR_LEN:
+			if (c > SCREEN_MAX_PAYLOAD)
+			{
+				// NAK it now, but don't draw the payload and CRC
+				UART_putc(NAK);
+				scr_len = c;
+				scr_n = 0;
+				scr_state = SCR_SKIP;
+				break;
+			}
+			scr_len = c;
+			scr_n = 0;
+			scr_crc = crc8(scr_crc, c);
+			scr_state = c ? SCR_PAYLOAD : SCR_CRC;
+			break;
+
+		case SCR_PAYLOAD:
+			scr_buf[scr_n++] = c;
+			scr_crc = crc8(scr_crc, c);
+			if (scr_n == scr_len)
+				scr_state = SCR_CRC;
+			break;
+
+		case SCR_CRC:
+			scr_state = SCR_IDLE;
+			if (c == scr_crc && screen_apply())
+				UART_putc(ACK);
+			else
+				UART_putc(NAK);
+			break;
+
+		case SCR_SKIP:
+			if (scr_n++ == scr_len)
+				scr_state = SCR_IDLE;
+			break;
+	}
+
+	return 1;
+}
+
+#endif
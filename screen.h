@@ -0,0 +1,56 @@
+/**************************************************************************
+ *
+ * SCREEN.H - Framed binary screen update protocol definitions
+ * An opt-in alternative to the character stream for hosts that refresh
+ * structured screens. A frame is
+ *
+ *   DLE  op  len  payload[len]  crc
+ *
+ * where crc is the CRC-8 (poly 0x07, init 0) of op, len and the payload.
+ * Every frame is answered with ACK, or NAK if the CRC, opcode or
+ * arguments are bad; a NAKed frame changes nothing. A len over
+ * SCREEN_MAX_PAYLOAD is NAKed at once and the rest of the frame skipped.
+ * Payloads start with row and column:
+ *
+ *   'W' row col data...   write the data bytes from row/col on
+ *   'F' row col n ch      write n copies of ch from row/col on
+ *   'C' row col w h       clear a w by h region to spaces
+ *   'G' row col           move the cursor to row/col
+ *
+ * Frames are applied to the shadow display (see lcd_norw.h), so cells
+ * that already hold the right character are not rewritten. The cursor is
+ * left after the last cell written.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __SCREEN_H__
+#define __SCREEN_H__
+
+#include <stdint.h>
+
+#include "lcd_norw.h"
+
+//#define SCREEN_PROTO		/* compile the frame receiver in, the mega profiles do */
+
+#if defined(SCREEN_PROTO) && !LCD_SHADOW
+#error "SCREEN_PROTO draws through the shadow copy, it needs LCD_SHADOW in lcd_norw.h"
+#endif
+
+#define SCR_WRITE	'W'
+#define SCR_FILL	'F'
+#define SCR_CLEAR	'C'
+#define SCR_GOTO	'G'
+
+#define SCREEN_MAX_PAYLOAD	(LCD_DISP_LENGTH + 2)
+
+// A frame is dropped if the host pauses longer than this between bytes
+#define SCREEN_TIMEOUT		CLOCK_US(20000)
+
+#ifdef SCREEN_PROTO
+uint8_t screen_rx(uint8_t c);
+#endif
+
+#endif //__SCREEN_H__
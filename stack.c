@@ -0,0 +1,50 @@
+/**************************************************************************
+ *
+ * STACK.C - Stack painting and high-water mark
+ * See stack.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include "stack.h"
+
+extern uint8_t _end;		// from the linker script, after .bss and .noinit
+extern uint8_t __stack;		// RAMEND
+
+void stack_paint(void) __attribute__ ((naked, used, section (".init1")));
+
+// Runs from .init1, before the stack pointer and r1 are set up, so it is
+// plain assembler that touches nothing but r24, r25 and Z
+void stack_paint(void)
+{
+	__asm volatile (
+		"	ldi r30, lo8(_end)\n"
+		"	ldi r31, hi8(_end)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(__stack)\n"
+		"	rjmp 2f\n"
+		"1:	st Z+, r24\n"
+		"2:	cpi r30, lo8(__stack)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		"	breq 1b\n"
+		:: "M" (STACK_CANARY));
+}
+
+// Counts the canary bytes left above the static variables
+uint16_t stack_unused(void)
+{
+	const uint8_t *p = &_end;
+	uint16_t n = 0;
+
+	while (p <= &__stack && *p == STACK_CANARY)
+	{
+		p++;
+		n++;
+	}
+	return n;
+}
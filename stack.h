@@ -0,0 +1,27 @@
+/**************************************************************************
+ *
+ * STACK.H - Stack high-water mark definitions
+ * At reset, before the C runtime sets anything up, the RAM between the
+ * end of the static variables (_end) and the top of the stack is filled
+ * with STACK_CANARY. The stack grows down into it, so the canary bytes
+ * still left at the bottom are the headroom that was never used, by
+ * main code and ISRs together. It is reported as the last field of the
+ * ESC CMD_STATS reply; at 0 the stack has reached the static variables.
+ *
+ * ramcheck.py gives the static side of the same budget at build time.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __STACK_H__
+#define __STACK_H__
+
+#include <stdint.h>
+
+#define STACK_CANARY	0xc5
+
+uint16_t stack_unused(void);
+
+#endif //__STACK_H__
@@ -0,0 +1,21 @@
+/**************************************************************************
+ *
+ * AVR/EEPROM.H - Host stand-in for the avr-libc EEPROM functions
+ * EEMEM variables are ordinary RAM on the host, see regs.c.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_AVR_EEPROM_H__
+#define __HOST_AVR_EEPROM_H__
+
+#include <stdint.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t *p);
+void eeprom_update_byte(uint8_t *p, uint8_t value);
+
+#endif //__HOST_AVR_EEPROM_H__
@@ -0,0 +1,24 @@
+/**************************************************************************
+ *
+ * AVR/INTERRUPT.H - Host stand-in for the avr-libc interrupt macros
+ * An ISR is an ordinary function the tests call to deliver the
+ * interrupt. cli() and sei() only move the I bit in SREG, so a test
+ * can check whether code runs with interrupts off.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_AVR_INTERRUPT_H__
+#define __HOST_AVR_INTERRUPT_H__
+
+#include <avr/io.h>
+
+#define SREG_I		0x80
+
+#define ISR(vector, ...)	void vector(void); void vector(void)
+#define cli()		(SREG &= ~SREG_I)
+#define sei()		(SREG |= SREG_I)
+
+#endif //__HOST_AVR_INTERRUPT_H__
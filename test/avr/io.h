@@ -0,0 +1,122 @@
+/**************************************************************************
+ *
+ * AVR/IO.H - Host stand-in for the avr-libc register definitions
+ * Used by the host build in test/ only. Every I/O register is a plain
+ * variable (see regs.c), so the firmware sources compile unchanged and
+ * the tests can set pins and flags and look at what was written. The
+ * bit numbers are the ones of the parts the board profiles cover.
+ *
+ * TCNT1 advances by one tick each time it is read, so busy-waits on
+ * Timer1 (the LCD timing, the PS/2 request-to-send) end on the host.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_AVR_IO_H__
+#define __HOST_AVR_IO_H__
+
+#include <stdint.h>
+
+#define _BV(b)			(1 << (b))
+#define bit_is_set(r, b)	((r) & _BV(b))
+#define bit_is_clear(r, b)	(!((r) & _BV(b)))
+
+#define HOST_REG(r)		extern volatile uint8_t r;
+
+HOST_REG(PORTA) HOST_REG(DDRA) HOST_REG(PINA)
+HOST_REG(PORTB) HOST_REG(DDRB) HOST_REG(PINB)
+HOST_REG(PORTC) HOST_REG(DDRC) HOST_REG(PINC)
+HOST_REG(PORTD) HOST_REG(DDRD) HOST_REG(PIND)
+HOST_REG(SREG) HOST_REG(MCUSR) HOST_REG(OSCCAL)
+HOST_REG(GPIOR0) HOST_REG(GPIOR1) HOST_REG(GPIOR2)
+
+// USART (ATtiny4313) and USART0 (ATmega)
+HOST_REG(UDR) HOST_REG(UCSRA) HOST_REG(UCSRB) HOST_REG(UCSRC) HOST_REG(UBRRL) HOST_REG(UBRRH)
+HOST_REG(UDR0) HOST_REG(UCSR0A) HOST_REG(UCSR0B) HOST_REG(UCSR0C) HOST_REG(UBRR0L) HOST_REG(UBRR0H)
+
+// External interrupts
+HOST_REG(MCUCR) HOST_REG(GIMSK) HOST_REG(GIFR) HOST_REG(EIFR) HOST_REG(EICRA) HOST_REG(EIMSK)
+
+// Timers
+HOST_REG(TCCR0A) HOST_REG(TCCR0B) HOST_REG(OCR0A) HOST_REG(TIMSK) HOST_REG(TIFR)
+HOST_REG(TIMSK0) HOST_REG(TIFR0) HOST_REG(TCCR1A) HOST_REG(TCCR1B)
+
+// USI and watchdog
+HOST_REG(USICR) HOST_REG(USISR) HOST_REG(USIDR) HOST_REG(USIBR)
+HOST_REG(WDTCR) HOST_REG(WDTCSR)
+
+uint16_t host_tcnt1(void);
+#define TCNT1			host_tcnt1()
+
+// Port bits
+enum { PA0, PA1, PA2 };
+enum { PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7 };
+enum { PC0, PC1, PC2, PC3, PC4, PC5, PC6 };
+enum { PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7 };
+
+// USART bits, the same for USART and USART0
+#define MPCM	0
+#define U2X	1
+#define UPE	2
+#define DOR	3
+#define FE	4
+#define UDRE	5
+#define TXC	6
+#define RXC	7
+#define TXB8	0
+#define RXB8	1
+#define UCSZ2	2
+#define TXEN	3
+#define RXEN	4
+#define UDRIE	5
+#define TXCIE	6
+#define RXCIE	7
+#define MPCM0	MPCM
+#define DOR0	DOR
+#define FE0	FE
+#define UDRE0	UDRE
+#define TXC0	TXC
+#define TXB80	TXB8
+#define RXB80	RXB8
+#define UCSZ02	UCSZ2
+#define TXEN0	TXEN
+#define RXEN0	RXEN
+#define UDRIE0	UDRIE
+#define TXCIE0	TXCIE
+#define RXCIE0	RXCIE
+
+// External interrupt bits
+#define ISC10	2
+#define ISC11	3
+#define INT0	6
+#define INT1	7
+#define INTF1	7
+
+// Timer bits
+#define WGM01	1
+#define CS00	0
+#define CS01	1
+#define CS02	2
+#define CS11	1
+#define OCIE0A	0
+#define OCF0A	0
+
+// USI bits
+#define USITC	0
+#define USICLK	1
+#define USICS0	2
+#define USICS1	3
+#define USIWM0	4
+#define USIWM1	5
+#define USIOIE	6
+#define USIOIF	6
+
+// Reset flags
+#define PORF	0
+#define EXTRF	1
+#define BORF	2
+#define WDRF	3
+
+#endif //__HOST_AVR_IO_H__
@@ -0,0 +1,21 @@
+/**************************************************************************
+ *
+ * AVR/PGMSPACE.H - Host stand-in for the avr-libc flash access macros
+ * There is one address space on the host, flash reads are plain reads.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_AVR_PGMSPACE_H__
+#define __HOST_AVR_PGMSPACE_H__
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)			(s)
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(p))
+
+#endif //__HOST_AVR_PGMSPACE_H__
@@ -0,0 +1,20 @@
+/**************************************************************************
+ *
+ * AVR/WDT.H - Host stand-in for the avr-libc watchdog macros
+ * There is no watchdog on the host.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_AVR_WDT_H__
+#define __HOST_AVR_WDT_H__
+
+#define WDTO_500MS	5
+
+#define wdt_enable(timeout)	((void)(timeout))
+#define wdt_disable()		((void)0)
+#define wdt_reset()		((void)0)
+
+#endif //__HOST_AVR_WDT_H__
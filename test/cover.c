@@ -0,0 +1,22 @@
+/**************************************************************************
+ *
+ * COVER.C - Basic block counter for the worst case runs
+ * The firmware objects are compiled with -fsanitize-coverage=trace-pc,
+ * which calls this at the start of every basic block. The count stands
+ * in for cycles: at -O0 the blocks follow the source, so it moves when
+ * the decoders do more work and not with the host compiler's moods.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include "host.h"
+
+void __sanitizer_cov_trace_pc(void);
+
+void __sanitizer_cov_trace_pc(void)
+{
+	host_blocks++;
+}
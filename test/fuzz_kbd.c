@@ -0,0 +1,190 @@
+/**************************************************************************
+ *
+ * FUZZ_KBD.C - Fuzz target for the PS/2 receiver and key decoder
+ * libFuzzer entry point (make fuzz), also run over the corpus and a
+ * batch of random inputs by the plain host build (see fuzz_main.c).
+ *
+ * The first byte picks the mode, the rest is the keyboard's side:
+ *
+ *   bit 0     read with kbd_getchar() instead of kbd_get_event()
+ *   bits 1-3  scancodes queued between reads, less one
+ *   bit 4     line mode: each byte is a clock edge into the INT1
+ *             receiver, bit 0 the data level, bit 1 a millisecond tick
+ *             first (so frames can time out)
+ *   bit 5     raw: no keymap lookups, every event has c = 0
+ *
+ * After every read the decoder state is checked: queue and event ring
+ * indices in range, the Pause skip count at most 2, the receiver's bit
+ * count at most 11. Every event must be consistent with the modifier it
+ * reports, and kbd_getchar() must never hand out a sequence code. At the
+ * end no modifier may be stuck: once the keyboard has sent the release
+ * of every modifier and lock key nothing is held, and its BAT code
+ * clears everything whatever came before.
+ *
+ * Bytes for the keyboard (LED updates, resend requests) are clocked out
+ * as a keyboard would, with no reply.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "ps2kbd.h"
+#include "host.h"
+
+#define HELD	(KBD_SHIFT | KBD_CTRL | KBD_ALT | KBD_ALTGR | KBD_LOCKED)
+
+void KBD_INT(void);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Releases of shift, ctrl, alt, altgr and the lock keys
+static const uint8_t kbd_release[] = {
+	0xf0, 0x12, 0xf0, 0x59, 0xf0, 0x14, 0xe0, 0xf0, 0x14, 0xf0, 0x11,
+	0xe0, 0xf0, 0x11, 0xf0, 0x77, 0xf0, 0x58, 0xf0, 0x7e
+};
+
+// Prefixes, replies, modifiers, locks and a few plain keys, see fuzz_main.c
+const uint8_t fuzz_dict[] = {
+	0xe0, 0xf0, 0xe1, 0xaa, 0xfa, 0xfe, 0x00, 0xff,
+	0x12, 0x59, 0x14, 0x11, 0x77, 0x58, 0x7e,
+	0x1c, 0x5a, 0x66, 0x75, 0x70, 0x69, 0x7c
+};
+const uint8_t fuzz_dict_n = sizeof(fuzz_dict);
+
+static void check_state(void)
+{
+	assert(SREG & SREG_I);
+	assert(kbd_queue_head < KBD_BUFSIZE && kbd_queue_tail < KBD_BUFSIZE);
+	assert(kbd_evn <= KBD_EVSIZE);
+	assert(kbd_ev_head < KBD_EVSIZE && kbd_ev_tail < KBD_EVSIZE);
+	assert(((kbd_ev_head - kbd_ev_tail) & (KBD_EVSIZE - 1)) == (kbd_evn & (KBD_EVSIZE - 1)));
+	assert(kbd_txn <= KBD_TXSIZE);
+	assert(kbd_skip <= 2);
+	assert(kbd_bit_n <= 11);
+}
+
+static void check_event(const kbd_event_t *ev)
+{
+	uint8_t brk = ev->flags & KEV_BREAK;
+
+	// Prefixes, acks and the BAT code never make an event
+	assert(ev->code != 0xe0 && ev->code != 0xe1 && ev->code != 0xf0);
+	assert(ev->code != 0xfa && ev->code != 0xaa);
+
+	// Releases carry no character, nor does anything in raw mode. AltGr
+	// is a kind of Alt.
+	assert(!brk || !ev->c);
+	assert(!kbd_raw || !ev->c);
+	assert(!(ev->flags & KEV_ALTGR) || (ev->flags & KEV_ALT));
+
+	// The flags are the modifiers as held after the key. E0 12 is the fake
+	// shift around Print Screen, it doesn't press shift but does release it.
+	if (ev->code == 0x12 || ev->code == 0x59)
+		assert(brk ? !(ev->flags & KEV_SHIFT) : (ev->flags & (KEV_SHIFT | KEV_EXT)) != 0);
+	if (ev->code == 0x14)
+		assert(brk ? !(ev->flags & KEV_CTRL) : (ev->flags & KEV_CTRL) != 0);
+	if (ev->code == 0x11)
+		assert(brk ? !(ev->flags & KEV_ALT) : (ev->flags & KEV_ALT) != 0);
+}
+
+static void kbd_read(uint8_t getchar)
+{
+	kbd_event_t ev;
+	unsigned char c;
+	uint16_t n;
+
+	for (n = 0; ; n++)
+	{
+		assert(n < 1000);
+		if (getchar)
+		{
+			// Sequences come out one byte at a time
+			c = kbd_getchar();
+			assert(!kbd_sequence(c));
+		} else if ((c = kbd_get_event(&ev)))
+			check_event(&ev);
+		check_state();
+		host_kbd_listen();
+
+		// A 00 from the keyboard (overrun) ends a pass early
+		if (!c && kbd_queue_head == kbd_queue_tail && !kbd_seq)
+			break;
+	}
+}
+
+static void kbd_feed(const uint8_t *sc, size_t n, uint8_t getchar)
+{
+	while (n--)
+	{
+		cli();
+		kbd_kbd_queue_scancode(*sc++);
+		sei();
+		if (((kbd_queue_head + 1) & (KBD_BUFSIZE - 1)) == kbd_queue_tail)
+			kbd_read(getchar);
+	}
+	kbd_read(getchar);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	uint8_t mode, chunk, c;
+	size_t i;
+
+	if (!size)
+		return 0;
+	mode = *data++;
+	size--;
+
+	host_reset();
+	kbd_init();
+	kbd_set_raw(mode & 0x20);
+
+	if (mode & 0x10)
+	{
+		for (i = 0; i < size; i++)
+		{
+			c = data[i];
+			if (c & 0x02)
+				host_ms(1);
+			if (c & 0x01)
+				PIND |= _BV(KBD_DATA_BIT);
+			else
+				PIND &= ~_BV(KBD_DATA_BIT);
+			if (HAL_EIMSK & _BV(HAL_INT1))
+				KBD_INT();
+			check_state();
+		}
+		kbd_read(mode & 0x01);
+	}
+	else
+	{
+		chunk = ((mode >> 1) & 0x07) + 1;
+		for (i = 0; i < size; i += chunk)
+			kbd_feed(data + i, size - i < chunk ? size - i : chunk, mode & 0x01);
+	}
+
+	// No modifier stays stuck. A Pause cut short may still swallow up to
+	// two codes, so the releases go twice then.
+	host_ms(KBD_TIMEOUT_MS + 1);
+	kbd_read(mode & 0x01);
+	c = kbd_skip;
+	kbd_feed(kbd_release, sizeof(kbd_release), mode & 0x01);
+	if (c)
+		kbd_feed(kbd_release, sizeof(kbd_release), mode & 0x01);
+	assert(!(kbd_status & (HELD | KBD_EX | KBD_BREAK)));
+
+	// BAT clears everything, even after a prefix
+	kbd_feed(data, size < 4 ? size : 4, mode & 0x01);
+	c = 0xaa;
+	kbd_feed(&c, 1, mode & 0x01);
+	assert(!(kbd_status & (HELD | KBD_EX | KBD_BREAK)));
+	assert(!kbd_skip);
+
+	return 0;
+}
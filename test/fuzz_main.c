@@ -0,0 +1,84 @@
+/**************************************************************************
+ *
+ * FUZZ_MAIN.C - Driver for the fuzz targets without libFuzzer
+ * Runs LLVMFuzzerTestOneInput() over the files given, or when there are
+ * none over FUZZ_RUNS random inputs. The random bytes are drawn half
+ * from the whole range and half from the target's dictionary (prefixes,
+ * ESC commands and the like), so the decoders get past their first
+ * state. The seed is fixed so a failure shows up again on the next run;
+ * -s picks another one, -n another count.
+ *
+ * With clang the targets are linked with -fsanitize=fuzzer instead and
+ * this file is not used, see the Makefile.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUZZ_RUNS	20000
+#define FUZZ_MAX	512	/* longest random input */
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Bytes worth trying more often, from the target
+extern const uint8_t fuzz_dict[];
+extern const uint8_t fuzz_dict_n;
+
+static uint8_t buf[1 << 16];
+
+static int run_file(const char *name)
+{
+	FILE *f = fopen(name, "rb");
+	size_t n;
+
+	if (!f)
+	{
+		perror(name);
+		return 1;
+	}
+	n = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+	LLVMFuzzerTestOneInput(buf, n);
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long runs = FUZZ_RUNS, seed = 1, r;
+	size_t n, i;
+	int a, files = 0, err = 0;
+
+	for (a = 1; a < argc; a++)
+	{
+		if (!strcmp(argv[a], "-s") && a + 1 < argc)
+			seed = strtoul(argv[++a], 0, 0);
+		else if (!strcmp(argv[a], "-n") && a + 1 < argc)
+			runs = strtoul(argv[++a], 0, 0);
+		else
+		{
+			err |= run_file(argv[a]);
+			files++;
+		}
+	}
+	if (files)
+		return err;
+
+	srand(seed);
+	for (r = 0; r < runs; r++)
+	{
+		n = 1 + rand() % FUZZ_MAX;
+		for (i = 0; i < n; i++)
+			buf[i] = (rand() & 1) ? fuzz_dict[rand() % fuzz_dict_n] : rand();
+		LLVMFuzzerTestOneInput(buf, n);
+	}
+	printf("%s: %lu random inputs ok, seed %lu\n", argv[0], runs, seed);
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+/**************************************************************************
+ *
+ * FUZZ_TERM.C - Fuzz target for the whole terminal
+ * libFuzzer entry point (make fuzz), also run over the corpus and a
+ * batch of random inputs by the plain host build (see fuzz_main.c).
+ *
+ * The first byte sets echo (bit 0) and LF add (bit 1), the rest is a
+ * capture in the format of replay.h: header then data, so serial bytes
+ * go through the RX interrupt and process_char(), scancodes through the
+ * decoder and task_kbd(). An input that trips an assert can be turned
+ * into an "R ..." line and loaded into a mega board with ESC 6.
+ *
+ * The invariants are checked after every task call, see term.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "term.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Headers, ESC commands, control and UTF-8 bytes, PS/2 prefixes and
+// modifiers, see fuzz_main.c
+const uint8_t fuzz_dict[] = {
+	0x00, 0x01, 0x80, 0x81,
+	0x1b, 'Z', '0', '2', '3', '4', '5', '6', '8', '9', ':', ';',
+	0x0d, 0x0a, 0x08, 0x09, 0x0c, 0x10, 0x7f,
+	0xc3, 0xa9, 0xe2, 0x82, 0xac, 0xed, 0xa0, 0xf0,
+	0xe0, 0xe1, 0x12, 0x14, 0x11, 0x58, 0x77, 0x5a, 0x66, 0x1c
+};
+const uint8_t fuzz_dict_n = sizeof(fuzz_dict);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	size_t i;
+
+	if (!size)
+		return 0;
+
+	term_reset(data[0]);
+	for (i = 1; i + 1 < size; i += 2)
+		term_entry(data[i], data[i + 1]);
+	term_run();
+
+	return 0;
+}
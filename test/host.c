@@ -0,0 +1,100 @@
+/**************************************************************************
+ *
+ * HOST.C - Host build support for the tests and fuzz targets
+ * See host.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "host.h"
+#include "clock.h"
+#include "sched.h"
+#include "ps2kbd.h"
+
+// The scheduler's timeout slots and its tick, see sched.c
+extern uint16_t sched_due[SCHED_TIMERS];
+extern sched_fn_t sched_fn[SCHED_TIMERS];
+void TIMER0_COMPA_vect(void);
+void KBD_INT(void);
+
+// Stand-ins for stack.c and wdog.c, which need the AVR linker script
+uint8_t wdog_cause;
+uint8_t wdog_resets;
+uint8_t wdog_warm;
+
+uint16_t stack_unused(void)
+{
+	return 0;
+}
+
+void host_reset(void)
+{
+	PORTA = DDRA = PINA = 0;
+	PORTB = DDRB = PINB = 0;
+	PORTC = DDRC = PINC = 0;
+	PORTD = DDRD = PIND = 0;
+	UCSRA = UCSRB = UCSR0A = UCSR0B = 0;
+	MCUCR = GIMSK = EICRA = EIMSK = 0;
+	USICR = USISR = 0;
+	SREG = SREG_I;
+	memset(sched_fn, 0, sizeof(sched_fn));
+
+	// Both PS/2 lines idle high
+	PIND = _BV(KBD_DATA_BIT) | _BV(KBD_CLOCK_BIT);
+	kbd_bit_n = 1;
+	kbd_n_bits = 0;
+	kbd_buffer = 0;
+	kbd_queue_head = kbd_queue_tail = 0;
+	kbd_timeout = 0;
+	kbd_status = 0;
+	kbd_txn = 0;
+	kbd_cmdn = 0;
+	kbd_skip = 0;
+	kbd_seq = 0;
+	kbd_ev_head = 0;
+	kbd_ev_tail = 0;
+	kbd_evn = 0;
+	kbd_raw = 0;
+}
+
+// As sched_run() does between tasks: the tick first, then what is due
+void host_ms(uint16_t n)
+{
+	uint8_t i;
+	sched_fn_t fn;
+
+	while (n--)
+	{
+		host_ticks += CLOCK_US(1000);
+		TIMER0_COMPA_vect();
+
+		for (i = 0; i < SCHED_TIMERS; i++)
+		{
+			fn = sched_fn[i];
+			if (fn && (int16_t)(sched_ms - sched_due[i]) >= 0)
+			{
+				sched_fn[i] = 0;
+				fn();
+			}
+		}
+	}
+}
+
+// The keyboard's side of a send: once the request-to-send is over, clock
+// the byte out and give the ack, with no reply
+void host_kbd_listen(void)
+{
+	uint8_t i;
+
+	if (kbd_status & KBD_RTS)
+		host_ms(2);
+	if (kbd_status & KBD_SEND)
+		for (i = 0; i < 11; i++)
+			KBD_INT();
+}
@@ -0,0 +1,41 @@
+/**************************************************************************
+ *
+ * HOST.H - Host build support for the tests and fuzz targets
+ * The firmware sources are compiled for the PC against the stand-in
+ * headers in avr/ and util/, with the I/O registers as variables (see
+ * regs.c). This module stands in for the parts that are linker script
+ * or assembler only (stack.c, wdog.c), and runs
+ * the millisecond tick and the sched_after() timeouts, which on the
+ * target come from Timer0 and sched_run().
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_H__
+#define __HOST_H__
+
+#include <stdint.h>
+
+extern uint16_t host_ticks;		/* Timer1, see avr/io.h */
+extern uint32_t host_blocks;		/* firmware basic blocks run, see cover.c */
+
+// PS/2 receiver and decoder state, see ps2kbd.c
+extern volatile uint8_t kbd_bit_n, kbd_n_bits, kbd_buffer;
+extern volatile uint8_t kbd_queue_head, kbd_queue_tail;
+extern volatile uint16_t kbd_status;
+extern uint8_t kbd_txn, kbd_cmdn, kbd_skip, kbd_ev_head, kbd_ev_tail, kbd_evn, kbd_raw;
+extern const unsigned char *kbd_seq;
+
+// Power-on state: registers cleared, interrupts on, no timeouts pending,
+// the PS/2 receiver and decoder idle with nothing held down
+void host_reset(void);
+
+// Runs n millisecond ticks, each followed by the timeouts that are due
+void host_ms(uint16_t n);
+
+// Takes a byte the firmware is sending to the keyboard, if there is one
+void host_kbd_listen(void);
+
+#endif //__HOST_H__
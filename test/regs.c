@@ -0,0 +1,50 @@
+/**************************************************************************
+ *
+ * REGS.C - I/O registers and EEPROM for the host build
+ * The variables behind the stand-in avr/io.h and avr/eeprom.h, on their
+ * own so a test of a single module (rs485_bus.c) can link without the
+ * scheduler and the keyboard driver that host.c brings in.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "host.h"
+
+#define HOST_REG_DEF(r)		volatile uint8_t r;
+
+HOST_REG_DEF(PORTA) HOST_REG_DEF(DDRA) HOST_REG_DEF(PINA)
+HOST_REG_DEF(PORTB) HOST_REG_DEF(DDRB) HOST_REG_DEF(PINB)
+HOST_REG_DEF(PORTC) HOST_REG_DEF(DDRC) HOST_REG_DEF(PINC)
+HOST_REG_DEF(PORTD) HOST_REG_DEF(DDRD) HOST_REG_DEF(PIND)
+HOST_REG_DEF(SREG) HOST_REG_DEF(MCUSR) HOST_REG_DEF(OSCCAL)
+HOST_REG_DEF(GPIOR0) HOST_REG_DEF(GPIOR1) HOST_REG_DEF(GPIOR2)
+HOST_REG_DEF(UDR) HOST_REG_DEF(UCSRA) HOST_REG_DEF(UCSRB) HOST_REG_DEF(UCSRC) HOST_REG_DEF(UBRRL) HOST_REG_DEF(UBRRH)
+HOST_REG_DEF(UDR0) HOST_REG_DEF(UCSR0A) HOST_REG_DEF(UCSR0B) HOST_REG_DEF(UCSR0C) HOST_REG_DEF(UBRR0L) HOST_REG_DEF(UBRR0H)
+HOST_REG_DEF(MCUCR) HOST_REG_DEF(GIMSK) HOST_REG_DEF(GIFR) HOST_REG_DEF(EIFR) HOST_REG_DEF(EICRA) HOST_REG_DEF(EIMSK)
+HOST_REG_DEF(TCCR0A) HOST_REG_DEF(TCCR0B) HOST_REG_DEF(OCR0A) HOST_REG_DEF(TIMSK) HOST_REG_DEF(TIFR)
+HOST_REG_DEF(TIMSK0) HOST_REG_DEF(TIFR0) HOST_REG_DEF(TCCR1A) HOST_REG_DEF(TCCR1B)
+HOST_REG_DEF(USICR) HOST_REG_DEF(USISR) HOST_REG_DEF(USIDR) HOST_REG_DEF(USIBR)
+HOST_REG_DEF(WDTCR) HOST_REG_DEF(WDTCSR)
+
+uint16_t host_ticks;
+uint32_t host_blocks;
+
+uint16_t host_tcnt1(void)
+{
+	return host_ticks++;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	return *p;
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+	*p = value;
+}
@@ -0,0 +1,359 @@
+/**************************************************************************
+ *
+ * RS485_BUS.C - Multi-drop bus test for the RS-485 mode of uart.c
+ * Three units with uart.c built with RS485 share a simulated bus with
+ * the host. Each unit has its own copy of the driver state and USART
+ * registers, swapped in around every call. The bus delivers each frame,
+ * with its 9th bit, to every receiver but the sender's. A USART with
+ * MPCM set drops data frames, as the real one does. What gets past is
+ * handed to rs485_rx() as the RX interrupt does.
+ *
+ * Covered: select, broadcast, poll, the turnaround wait, the end frame,
+ * releasing the bus, and that units not polled never drive the bus or
+ * take data meant for another unit.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "uart.h"
+
+#define UNITS		3
+#define RX_MAX		64
+
+// Driver state in uart.c
+extern volatile char tx_buf[UART_TX_BUFSIZE];
+extern volatile uint8_t tx_tail;
+extern volatile uint8_t rs485_turn;
+extern uint8_t rs485_addr_ee;
+
+void HAL_USART_UDRE_vect(void);
+void HAL_USART_TX_vect(void);
+
+typedef struct
+{
+	char		tx_buf[UART_TX_BUFSIZE];
+	uint8_t		tx_head, tx_tail, tx_high;
+	uint8_t		addr, state, turn, addr_ee;
+	uint8_t		ucsra, ucsrb, udr, portd, ddrd;
+	uint8_t		rx[RX_MAX];	/* data frames it took */
+	uint8_t		rxn;
+} unit_t;
+
+static unit_t unit[UNITS];
+
+// Frames seen on the bus, bit 8 is the 9th bit
+static uint16_t bus[RX_MAX];
+static uint8_t busn;
+
+static void unit_in(unit_t *u)
+{
+	memcpy((char *)tx_buf, u->tx_buf, sizeof(u->tx_buf));
+	tx_head = u->tx_head;
+	tx_tail = u->tx_tail;
+	tx_high = u->tx_high;
+	rs485_addr = u->addr;
+	rs485_state = u->state;
+	rs485_turn = u->turn;
+	rs485_addr_ee = u->addr_ee;
+	HAL_UCSRA = u->ucsra;
+	HAL_UCSRB = u->ucsrb;
+	HAL_UDR = u->udr;
+	PORTD = u->portd;
+	DDRD = u->ddrd;
+}
+
+static void unit_out(unit_t *u)
+{
+	memcpy(u->tx_buf, (char *)tx_buf, sizeof(u->tx_buf));
+	u->tx_head = tx_head;
+	u->tx_tail = tx_tail;
+	u->tx_high = tx_high;
+	u->addr = rs485_addr;
+	u->state = rs485_state;
+	u->turn = rs485_turn;
+	u->addr_ee = rs485_addr_ee;
+	u->ucsra = HAL_UCSRA;
+	u->ucsrb = HAL_UCSRB;
+	u->udr = HAL_UDR;
+	u->portd = PORTD;
+	u->ddrd = DDRD;
+}
+
+static uint8_t unit_driving(const unit_t *u)
+{
+	return (u->portd & _BV(RS485_DE_PIN)) != 0;
+}
+
+// A frame on the bus, sent by unit from, or by the host for from = UNITS
+static void bus_frame(uint8_t c, uint8_t bit9, uint8_t from)
+{
+	uint8_t i;
+	unit_t *u;
+
+	assert(busn < RX_MAX);
+	bus[busn++] = c | (bit9 ? 0x100 : 0);
+
+	for (i = 0; i < UNITS; i++)
+	{
+		u = &unit[i];
+		if (i == from || (!bit9 && (u->ucsra & _BV(HAL_MPCM))))
+			continue;
+
+		unit_in(u);
+		if (bit9)
+			HAL_UCSRB |= _BV(HAL_RXB8);
+		else
+			HAL_UCSRB &= ~_BV(HAL_RXB8);
+		HAL_UDR = c;
+		if (rs485_rx(c, bit9))
+		{
+			assert(u->rxn < RX_MAX);
+			u->rx[u->rxn++] = c;
+		}
+		unit_out(u);
+	}
+}
+
+// Runs a unit's transmit interrupts for as long as they are enabled,
+// putting what it sends on the bus
+static void unit_run(uint8_t n)
+{
+	unit_t *u = &unit[n];
+	uint8_t t, state, c, bit9, i;
+
+	for (i = 0; i < 2 * UART_TX_BUFSIZE; i++)
+	{
+		unit_in(u);
+		if (HAL_UCSRB & _BV(HAL_UDRIE))
+		{
+			t = tx_tail;
+			state = rs485_state;
+			HAL_USART_UDRE_vect();
+			c = HAL_UDR;
+			bit9 = HAL_UCSRB & _BV(HAL_TXB8);
+			unit_out(u);
+			if (tx_tail != t || (state == RS485_TALK && rs485_state == RS485_END))
+			{
+				// Only a unit holding DE may put a frame on the bus
+				assert(unit_driving(u));
+				bus_frame(c, bit9, n);
+			}
+		}
+		else if ((HAL_UCSRB & _BV(HAL_TXCIE)) && rs485_state == RS485_END)
+		{
+			HAL_USART_TX_vect();
+			unit_out(u);
+		}
+		else
+		{
+			unit_out(u);
+			return;
+		}
+	}
+	assert(0);
+}
+
+static void unit_puts(uint8_t n, const char *s)
+{
+	unit_in(&unit[n]);
+	UART_puts(s);
+	unit_out(&unit[n]);
+	unit_run(n);
+}
+
+// A millisecond tick on every unit, then whatever it starts sending
+static void bus_ms(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < UNITS; i++)
+	{
+		unit_in(&unit[i]);
+		rs485_tick();
+		unit_out(&unit[i]);
+	}
+	for (i = 0; i < UNITS; i++)
+		unit_run(i);
+}
+
+// Nobody drives the bus, everybody listens for addresses only
+static void bus_idle(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < UNITS; i++)
+	{
+		assert(!unit_driving(&unit[i]));
+		assert(unit[i].state == RS485_IDLE);
+		assert(!(unit[i].ucsrb & (_BV(HAL_UDRIE) | _BV(HAL_TXCIE))));
+	}
+}
+
+static void rx_clear(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < UNITS; i++)
+		unit[i].rxn = 0;
+	busn = 0;
+}
+
+static void rx_check(uint8_t n, const char *s)
+{
+	assert(unit[n].rxn == strlen(s) && !memcmp(unit[n].rx, s, unit[n].rxn));
+}
+
+static void host_send(const char *s)
+{
+	while (*s)
+		bus_frame(*s++, 0, UNITS);
+}
+
+// Polls unit n and runs the bus until it has let go, checking the
+// turnaround and that only n answers with data then its end frame
+static void poll(uint8_t n, const char *reply)
+{
+	uint8_t i, ms;
+
+	rx_clear();
+	bus_frame(unit[n].addr | RS485_POLL, 1, UNITS);
+	assert(unit[n].state == RS485_TURN);
+	busn = 0;
+
+	for (ms = 0; unit[n].state != RS485_IDLE; ms++)
+	{
+		assert(ms < 10);
+		bus_ms();
+		// The host has RS485_TURN_MS whole ticks to get off the bus, the
+		// first one may come straight after the poll
+		if (ms < RS485_TURN_MS)
+			assert(!unit_driving(&unit[n]) && unit[n].state == RS485_TURN);
+		for (i = 0; i < UNITS; i++)
+			if (i != n)
+				assert(!unit_driving(&unit[i]));
+	}
+
+	assert(busn == strlen(reply) + 1);
+	for (i = 0; reply[i]; i++)
+		assert(bus[i] == (uint8_t)reply[i]);
+	assert(bus[i] == (0x100 | unit[n].addr));
+	for (i = 0; i < UNITS; i++)
+		assert(!unit[i].rxn);
+	assert(unit[n].tx_head == unit[n].tx_tail);
+	bus_idle();
+}
+
+int main(void)
+{
+	uint8_t i;
+
+	// Units 1, 2 and 3, from EEPROM at power-up
+	for (i = 0; i < UNITS; i++)
+	{
+		SREG = SREG_I;
+		unit_out(&unit[i]);
+		unit[i].addr_ee = i + 1;
+		unit_in(&unit[i]);
+		UART_init(BR9600);
+		unit_out(&unit[i]);
+		assert(unit[i].addr == i + 1);
+		assert(unit[i].ucsra & _BV(HAL_MPCM));
+		assert(unit[i].ddrd & _BV(RS485_DE_PIN));
+	}
+	bus_idle();
+
+	// Nothing gets through before a unit is selected
+	rx_clear();
+	host_send("lost");
+	for (i = 0; i < UNITS; i++)
+		assert(!unit[i].rxn);
+
+	// Select unit 2: only it takes the data
+	rx_clear();
+	bus_frame(2, 1, UNITS);
+	host_send("ab");
+	rx_check(0, "");
+	rx_check(1, "ab");
+	rx_check(2, "");
+
+	// Broadcast: everybody
+	rx_clear();
+	bus_frame(RS485_BROADCAST, 1, UNITS);
+	host_send("all");
+	for (i = 0; i < UNITS; i++)
+		rx_check(i, "all");
+
+	// Selecting unit 1 deselects the others
+	rx_clear();
+	bus_frame(1, 1, UNITS);
+	host_send("x");
+	rx_check(0, "x");
+	rx_check(1, "");
+	rx_check(2, "");
+
+	// Replies wait for the poll, nobody drives the bus meanwhile
+	rx_clear();
+	unit_puts(0, "one");
+	unit_puts(2, "three");
+	for (i = 0; i < 5; i++)
+		bus_ms();
+	bus_idle();
+	assert(!busn);
+
+	// Polls: data then the unit's address as the end frame, the polled
+	// unit is deselected and the others hear nothing of it
+	poll(2, "three");
+	poll(1, "");
+	poll(0, "one");
+	rx_clear();
+	host_send("y");
+	for (i = 0; i < UNITS; i++)
+		assert(!unit[i].rxn);
+
+	// A poll for another unit doesn't start a turnaround here
+	rx_clear();
+	bus_frame(0x7e | RS485_POLL, 1, UNITS);
+	for (i = 0; i < 3; i++)
+		bus_ms();
+	bus_idle();
+	assert(busn == 1);
+
+	// A second poll while answering changes nothing
+	unit_puts(1, "zz");
+	rx_clear();
+	bus_frame(2 | RS485_POLL, 1, UNITS);
+	bus_frame(2 | RS485_POLL, 1, UNITS);
+	assert(unit[1].state == RS485_TURN && unit[1].turn == RS485_TURN_MS + 1);
+	while (unit[1].state != RS485_IDLE)
+		bus_ms();
+	assert(busn == 5 && bus[2] == 'z' && bus[3] == 'z' && bus[4] == 0x102);
+
+	// ESC 7: new address kept in EEPROM, broadcast and out of range ignored
+	unit_in(&unit[2]);
+	rs485_set_addr(RS485_BROADCAST);
+	rs485_set_addr(RS485_ADDR_MAX);
+	assert(rs485_addr == 3);
+	rs485_set_addr(9);
+	unit_out(&unit[2]);
+	assert(unit[2].addr == 9 && unit[2].addr_ee == 9);
+	rx_clear();
+	bus_frame(3, 1, UNITS);
+	host_send("q");
+	for (i = 0; i < UNITS; i++)
+		assert(!unit[i].rxn);
+	bus_frame(9, 1, UNITS);
+	host_send("q");
+	rx_check(2, "q");
+	unit_puts(2, "9");
+	poll(2, "9");
+
+	printf("rs485_bus: " PROFILE " ok\n");
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+/**************************************************************************
+ *
+ * TERM.C - Host driver for the whole terminal
+ * See term.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <assert.h>
+
+#include "ps2_term.h"
+#include "replay.h"
+#include "host.h"
+#include "term.h"
+
+uint32_t term_kbd_max;
+uint32_t term_rx_max;
+
+// Not in the headers, the tests look at them
+extern uint8_t echo, lfadd, keys, esc;
+extern volatile uint8_t rx_head, rx_tail;
+extern uint8_t disp_head, disp_tail;
+extern const sched_task_t tasks[3];
+#ifdef UTF8
+extern uint8_t utf8_more;
+#endif
+#ifdef SCREEN_PROTO
+extern uint8_t scr_state, scr_n;
+#endif
+#ifdef REPLAY
+extern volatile uint16_t rec_n;
+#endif
+
+static void term_check(void)
+{
+	assert(SREG & SREG_I);
+	assert(rx_head < RX_BUFSIZE && rx_tail < RX_BUFSIZE);
+	assert(disp_head < DISP_BUFSIZE && disp_tail < DISP_BUFSIZE);
+#if LCD_SHADOW
+	assert(lcd_x <= LCD_SHADOW_LENGTH && lcd_y < LCD_LINES);
+#endif
+#if LCD_HSCROLL
+	assert(lcd_shift <= LCD_SHADOW_LENGTH - LCD_DISP_LENGTH);
+#endif
+	assert(echo == ON || echo == OFF);
+	assert(lfadd == ON || lfadd == OFF);
+	assert(esc == ON || esc == OFF);
+	assert(keys == KEYS_CHAR || keys == KEYS_RAW || keys == KEYS_TIME);
+	assert(kbd_raw == (keys != KEYS_CHAR));
+#ifdef UTF8
+	assert(utf8_more <= 3);
+#endif
+#ifdef SCREEN_PROTO
+	// SCR_SKIP (5, see screen.c) counts through a len that was too long
+	assert(scr_state <= 5 && (scr_state == 5 || scr_n <= SCREEN_MAX_PAYLOAD));
+#endif
+#ifdef REPLAY
+	assert(rec_n <= REC_SIZE);
+#endif
+}
+
+// Power-on, past the sign-on: the terminal screen is up and empty
+void term_reset(uint8_t flags)
+{
+	host_reset();
+	echo = (flags & TERM_ECHO) ? ON : OFF;
+	lfadd = (flags & TERM_LFADD) ? ON : OFF;
+	keys = KEYS_CHAR;
+	esc = OFF;
+	rx_head = rx_tail = 0;
+	disp_head = disp_tail = 0;
+#ifdef UTF8
+	utf8_more = 0;
+#endif
+#ifdef SCREEN_PROTO
+	scr_state = 0;		/* SCR_IDLE, see screen.c */
+	scr_n = 0;
+#endif
+#ifdef REPLAY
+	rec_state = REC_IDLE;
+	rec_n = 0;
+#endif
+	kbd_init();
+	lcd_init(LCD_DISP_ON);
+	show_terminal();
+	term_kbd_max = 0;
+	term_rx_max = 0;
+	term_check();
+}
+
+void HAL_USART_RX_vect(void);
+
+// A byte from the host, through the RX interrupt
+void term_rx(unsigned char c)
+{
+	HAL_UCSRA = 0;
+	HAL_UDR = c;
+	HAL_USART_RX_vect();
+	term_check();
+}
+
+// A scancode from the keyboard, as the PS/2 interrupt queues it
+void term_key(uint8_t sc)
+{
+	cli();
+	if (kbd_kbd_queue_scancode(sc))
+		kbd_frames++;
+	sei();
+}
+
+// A capture entry, see replay.h. Entries apart in time give the main
+// loop the chance to catch up first, back to back ones arrive together.
+void term_entry(uint8_t h, uint8_t c)
+{
+	if (h & REC_GAP_MAX)
+	{
+		term_run();
+		host_ms(h & REC_GAP_MAX);
+	}
+	if (h & REC_KBD)
+		term_key(c);
+	else
+		term_rx(c);
+}
+
+// The main loop until it is idle. While the LCD is busy time moves on.
+void term_run(void)
+{
+	uint32_t steps, b;
+	uint8_t i, r, idle = 0;
+
+	for (steps = 0; idle < 2; steps++)
+	{
+		assert(steps < TERM_STEPS);
+
+		for (i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++)
+		{
+			b = host_blocks;
+			r = tasks[i]();
+			b = host_blocks - b;
+			if (tasks[i] == task_kbd && b > term_kbd_max)
+				term_kbd_max = b;
+			if (tasks[i] == task_rx && b > term_rx_max)
+				term_rx_max = b;
+			term_check();
+			host_kbd_listen();
+			if (r)
+				break;
+		}
+
+		// Nothing ran: done unless the LCD is still busy with the queue
+		if (i == sizeof(tasks) / sizeof(tasks[0]))
+		{
+			if (disp_head == disp_tail && rx_head == rx_tail && !lcd_scrolling)
+				idle++;
+			host_ticks += 40;
+		}
+		else
+			idle = 0;
+	}
+}
@@ -0,0 +1,44 @@
+/**************************************************************************
+ *
+ * TERM.H - Host driver for the whole terminal
+ * Feeds serial bytes through the RX interrupt and scancodes into the
+ * PS/2 queue, and runs the main loop tasks the way sched_run() does
+ * until everything has been processed and drawn. After every task call
+ * the invariants are checked with assert():
+ *
+ *   - no task leaves interrupts off
+ *   - ring, queue and buffer indices stay inside their arrays
+ *   - the cursor stays on the shadow copy, the display shift in range
+ *   - echo, LF add, the ESC state and the key mode hold legal values
+ *   - the main loop comes back to idle within TERM_STEPS task calls
+ *
+ * Each run of task_kbd and task_rx is costed in basic blocks of the
+ * firmware code, when that is compiled with -fsanitize-coverage=trace-pc
+ * (see cover.c). The longest runs are what ESC 2 reports as "W" on the
+ * target, in Timer1 ticks there.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __TERM_H__
+#define __TERM_H__
+
+#include <stdint.h>
+
+#define TERM_STEPS	100000	/* task calls to come back to idle in */
+
+#define TERM_ECHO	0x01	/* term_reset() flags */
+#define TERM_LFADD	0x02
+
+extern uint32_t term_kbd_max;	/* longest task_kbd run, in blocks */
+extern uint32_t term_rx_max;	/* longest task_rx run, in blocks */
+
+void term_reset(uint8_t flags);
+void term_rx(unsigned char c);
+void term_key(uint8_t sc);
+void term_entry(uint8_t h, uint8_t c);
+void term_run(void);
+
+#endif //__TERM_H__
@@ -0,0 +1,56 @@
+/**************************************************************************
+ *
+ * UART_HOST.C - Serial output stand-in for the terminal fuzz target
+ * Replaces uart.c, whose senders wait for the UDRE interrupt to drain
+ * the TX ring. Here every byte goes straight into host_tx, so replies of
+ * any length come back at once and the tests can look at them.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "uart.h"
+#include "uart_host.h"
+
+volatile uint8_t tx_head = 0;
+volatile uint8_t tx_high = 0;
+
+unsigned char host_tx[HOST_TX_SIZE];
+uint16_t host_txn = 0;
+
+void UART_init(const uint8_t baud_rate)
+{
+	(void)baud_rate;
+}
+
+void UART_Send_Char(const char c)
+{
+	host_tx[host_txn++ & (HOST_TX_SIZE - 1)] = c;
+}
+
+void SendSTR_P(const char *FlashSTR)
+{
+	while (*FlashSTR)
+		UART_Send_Char(*FlashSTR++);
+}
+
+void UART_putc(const char c)
+{
+	UART_Send_Char(c);
+}
+
+void UART_puts(const char *s)
+{
+	while (*s)
+		UART_Send_Char(*s++);
+}
+
+void UART_puthex(const uint8_t b)
+{
+	UART_Send_Char("0123456789ABCDEF"[b >> 4]);
+	UART_Send_Char("0123456789ABCDEF"[b & 0x0F]);
+}
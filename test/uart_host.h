@@ -0,0 +1,21 @@
+/**************************************************************************
+ *
+ * UART_HOST.H - Serial output stand-in for the terminal fuzz target
+ * See uart_host.c.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __UART_HOST_H__
+#define __UART_HOST_H__
+
+#include <stdint.h>
+
+#define HOST_TX_SIZE	1024	/* last bytes sent kept, a power of 2 */
+
+extern unsigned char host_tx[HOST_TX_SIZE];
+extern uint16_t host_txn;	/* bytes sent, wraps */
+
+#endif //__UART_HOST_H__
@@ -0,0 +1,17 @@
+/**************************************************************************
+ *
+ * UTIL/DELAY.H - Host stand-in for the avr-libc delay loops
+ * Delays return straight away on the host.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __HOST_UTIL_DELAY_H__
+#define __HOST_UTIL_DELAY_H__
+
+#define _delay_us(us)	((void)(us))
+#define _delay_ms(ms)	((void)(ms))
+
+#endif //__HOST_UTIL_DELAY_H__
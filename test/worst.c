@@ -0,0 +1,196 @@
+/**************************************************************************
+ *
+ * WORST.C - Worst case input replay, the decoder cycle budget test
+ * Replays the capture in worst.rec through the whole terminal (see
+ * term.h), with echo and LF add on, and fails if the longest task_kbd
+ * or task_rx run is over the budget recorded for the profile. The
+ * count is basic blocks of the firmware code, which tracks the cycles
+ * the same code takes on the target.
+ *
+ * worst.rec holds, one per line:
+ *
+ *   B <profile> <kbd> <rx>   budget for a profile: the longest task_kbd
+ *                            and task_rx runs allowed, in basic blocks
+ *   R hhdd hhdd ...          the capture, as ESC 4 sends it
+ *
+ * anything else is a comment. The R line can be sent to a mega board
+ * after ESC 6 and played with ESC 5; ESC 2 then has the runs in Timer1
+ * ticks as "W".
+ *
+ * worst -s N looks for a worse capture: N random changes to the one in
+ * worst.rec, keeping each that makes either run longer, then prints the
+ * result as an R line with the runs it takes. A change that makes a run
+ * longer on purpose needs its budget raised in worst.rec, with the new
+ * capture if the search finds one.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "term.h"
+
+#ifndef PROFILE
+#define PROFILE		"t4313"
+#endif
+
+#define WORST_SIZE	128	/* most entries, fits the mega profiles' REC_SIZE */
+
+static uint8_t rec[WORST_SIZE][2];
+static uint16_t rec_len;
+static unsigned long budget_kbd, budget_rx;
+
+static void load(const char *name)
+{
+	FILE *f = fopen(name, "r");
+	char line[1024], prof[16], *p;
+	unsigned long kbd, rx;
+	unsigned int e;
+	int n;
+
+	if (!f)
+	{
+		perror(name);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f))
+	{
+		if (sscanf(line, "B %15s %lu %lu", prof, &kbd, &rx) == 3)
+		{
+			if (!strcmp(prof, PROFILE))
+			{
+				budget_kbd = kbd;
+				budget_rx = rx;
+			}
+		}
+		else if (line[0] == 'R')
+		{
+			for (p = line + 1; rec_len < WORST_SIZE && sscanf(p, " %4x%n", &e, &n) == 1; p += n)
+			{
+				rec[rec_len][0] = e >> 8;
+				rec[rec_len][1] = e;
+				rec_len++;
+			}
+		}
+	}
+	fclose(f);
+
+	if (!budget_kbd || !budget_rx || !rec_len)
+	{
+		fprintf(stderr, "%s: no budget for " PROFILE " or no capture\n", name);
+		exit(1);
+	}
+}
+
+static void replay(void)
+{
+	uint16_t i;
+
+	term_reset(TERM_ECHO | TERM_LFADD);
+	for (i = 0; i < rec_len; i++)
+		term_entry(rec[i][0], rec[i][1]);
+	term_run();
+}
+
+// One random change: a new byte, a new entry, or one dropped
+static void mutate(void)
+{
+	uint16_t i = rand() % rec_len;
+
+	switch (rand() % 4)
+	{
+	case 0:
+		rec[i][1] = rand();
+		break;
+	case 1:
+		rec[i][0] = (rec[i][0] & 0x80) | (rand() % 3);
+		break;
+	case 2:
+		if (rec_len < WORST_SIZE)
+		{
+			memmove(rec[i + 1], rec[i], (rec_len - i) * 2);
+			rec[i][0] = rand() & 0x81;
+			rec[i][1] = rand();
+			rec_len++;
+		}
+		break;
+	default:
+		if (rec_len > 1)
+		{
+			memmove(rec[i], rec[i + 1], (rec_len - i - 1) * 2);
+			rec_len--;
+		}
+		break;
+	}
+}
+
+static void search(unsigned long n)
+{
+	static uint8_t keep[WORST_SIZE][2];
+	uint16_t keep_len, i;
+	uint32_t kbd, rx;
+
+	replay();
+	kbd = term_kbd_max;
+	rx = term_rx_max;
+	while (n--)
+	{
+		memcpy(keep, rec, sizeof(rec));
+		keep_len = rec_len;
+		mutate();
+		replay();
+		if (term_kbd_max >= kbd && term_rx_max >= rx && (term_kbd_max > kbd || term_rx_max > rx))
+		{
+			kbd = term_kbd_max;
+			rx = term_rx_max;
+		}
+		else
+		{
+			memcpy(rec, keep, sizeof(rec));
+			rec_len = keep_len;
+		}
+	}
+
+	printf("B " PROFILE " %lu %lu\nR", (unsigned long)kbd, (unsigned long)rx);
+	for (i = 0; i < rec_len; i++)
+		printf(" %02X%02X", rec[i][0], rec[i][1]);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = "worst.rec";
+	unsigned long n = 0;
+	int a;
+
+	for (a = 1; a < argc; a++)
+	{
+		if (!strcmp(argv[a], "-s") && a + 1 < argc)
+			n = strtoul(argv[++a], 0, 0);
+		else
+			name = argv[a];
+	}
+	load(name);
+
+	if (n)
+	{
+		srand(1);
+		search(n);
+		return 0;
+	}
+
+	replay();
+	printf(PROFILE ": task_kbd %lu of %lu, task_rx %lu of %lu blocks\n",
+		(unsigned long)term_kbd_max, budget_kbd, (unsigned long)term_rx_max, budget_rx);
+	if (term_kbd_max > budget_kbd || term_rx_max > budget_rx)
+	{
+		printf(PROFILE ": over the budget in %s\n", name);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+/**************************************************************************
+ *
+ * TRACE.C - Event trace ring buffer
+ * See trace.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "trace.h"
+#include "uart.h"
+#include "ascii.h"
+
+#ifdef TRACE
+
+volatile uint16_t trace_time[TRACE_SIZE];
+volatile uint8_t trace_ev[TRACE_SIZE];
+volatile uint8_t trace_idx = 0;
+
+// Set up the optional trace pin
+void trace_init(void)
+{
+#ifdef TRACE_PIN
+	DDRD |= _BV(TRACE_PIN);
+#endif
+}
+
+// Sends the ring to the serial port, oldest entry first, as
+// "T ee:tttt ee:tttt ...". Unused entries are skipped. Recording is
+// paused meanwhile so the dump doesn't trace itself.
+void trace_dump(void)
+{
+	uint8_t i = trace_idx;
+	uint8_t n;
+
+	trace_idx = i | TRACE_PAUSED;
+
+	UART_putc('T');
+	for (n = 0; n < TRACE_SIZE; n++)
+	{
+		if (trace_ev[i])
+		{
+			UART_putc(' ');
+			UART_puthex(trace_ev[i]);
+			UART_putc(':');
+			UART_puthex(trace_time[i] >> 8);
+			UART_puthex(trace_time[i]);
+		}
+		i = (i + 1) & (TRACE_SIZE - 1);
+	}
+	UART_putc(CR);
+	UART_putc(LF);
+
+	trace_idx = i;
+}
+
+#endif
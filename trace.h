@@ -0,0 +1,78 @@
+/**************************************************************************
+ *
+ * TRACE.H - Event trace definitions
+ * Optional latency tracing: hot paths record an event ID and a Timer1
+ * timestamp (see clock.h) into a small RAM ring, which the host can dump
+ * with ESC CMD_TRACE. With TRACE undefined TRACE_EVENT() expands to
+ * nothing and trace.c is empty. When defined, each event costs a fixed
+ * ~25 cycles plus the optional pin toggle.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+#include <avr/io.h>
+#include "hal.h"
+#include "clock.h"
+
+//#define TRACE			/* compile the event trace in */
+//#define TRACE_PIN	PD6	/* also toggle this PORTD pin on every event */
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE	8	/* ring entries, a power of 2 up to 64 */
+#endif
+
+// Event IDs
+#define TR_RX		1	/* USART_RX_vect entered */
+#define TR_KBD_FRAME	2	/* PS/2 byte completed in ISR(KBD_INT) */
+#define TR_KBD_DECODE	3	/* kbd_getchar() decoded a key */
+#define TR_LCD_WRITE	4	/* lcd_write() called */
+#define TR_TX		5	/* UART_Send_Char() called */
+
+#ifdef TRACE
+
+extern volatile uint16_t trace_time[TRACE_SIZE];
+extern volatile uint8_t trace_ev[TRACE_SIZE];
+extern volatile uint8_t trace_idx;
+
+#define TRACE_PAUSED	0x80	/* set in trace_idx while the ring is dumped */
+
+static inline void trace_event(uint8_t ev)
+{
+	uint8_t sreg = SREG;
+	uint8_t i;
+
+	__asm__ __volatile__ ("cli" ::: "memory");
+	i = trace_idx;
+	if (!(i & TRACE_PAUSED))
+	{
+		trace_time[i] = CLOCK_NOW();
+		trace_ev[i] = ev;
+		trace_idx = (i + 1) & (TRACE_SIZE - 1);
+	}
+#ifdef TRACE_PIN
+	PIND = _BV(TRACE_PIN);		// writing a one to PINx toggles the pin
+#endif
+	SREG = sreg;
+}
+
+#define TRACE_EVENT(ev)	trace_event(ev)
+
+void trace_init(void);
+void trace_dump(void);
+
+#else
+
+#define TRACE_EVENT(ev)
+#define trace_init()
+#define trace_dump()
+
+#endif
+
+#endif //__TRACE_H__
@@ -1,146 +1,257 @@
-/**************************************************************************
- *
- * UART.C - ET-JRAVR UART Code
- * This is a library module that provides UART/USART functions that mimic
- * some LCD library functions. It can be used to initialize the UART/USART
- * and to send characters via the USART/UART. Note, the RX ISR is located
- * in the main module as it interacts with globals.
- *
- * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
- * All Rights Reserved
- *
- **************************************************************************/
-#include <stdint.h>
-#include <stdlib.h>
-#include <stdio.h>
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
-#include <avr/pgmspace.h>
-#include "uart.h"
-
-//char tbuf[16];
-
-void UART_init(const uint8_t baud_rate);
-void UART_Send_Char(const char c);
-void SendSTR_P(const char *FlashSTR);
-void UART_putc(const char c);
-void UART_puts(const char *s);
-
-// Initialize the UART
-void UART_init(const uint8_t baud_rate)
-{
-	// Set up UART
-	switch (baud_rate)
-	{
-		case BR1200:
-			UBRR = UBRR_1200;		// 1200Baud @ 8MHz
-			break;
-
-		case BR2400:
-			UBRR = UBRR_2400;		// 2400Baud @ 8MHz
-			break;
-
-		case BR4800:
-			UBRR = UBRR_4800;		// 2400Baud @ 8MHz
-			break;
-
-		case BR9600:
-			UBRR = UBRR_9600;		// 2400Baud @ 8MHz
-			break;
-
-		case BR14400:
-			UBRR = UBRR_14400;		// 2400Baud @ 8MHz
-			break;
-
-		case BR19200:
-			UBRR = UBRR_19200;		// 2400Baud @ 8MHz
-			break;
-
-		case BR28800:
-			UBRR = UBRR_28800;		// 2400Baud @ 8MHz
-			break;
-
-		case BR38400:
-			UBRR = UBRR_38400;		// 2400Baud @ 8MHz
-			break;
-
-		case BR57600:
-			UBRR = UBRR_57600;		// 2400Baud @ 8MHz
-			break;
-
-		case BR76800:
-			UBRR = UBRR_76800;		// 2400Baud @ 8MHz
-			break;
-
-		case BR115200:
-			UBRR = UBRR_115200;		// 2400Baud @ 8MHz
-			break;
-
-		default:
-			UBRR = UBRR_9600;		// 2400Baud @ 8MHz
-			break;
-	}
-	
-#ifdef ATtiny4313
-	UBRRH = 0;		// same for all baud rates
-#endif
-
-	// Turn on UART TX and RX
-#ifdef ATtiny4313
-	UCSRB |= _BV(RXEN) | _BV(TXEN);
-	UCSRB |= _BV(RXCIE ); // Enable the USART Recieve Complete interrupt ( USART_RXC )
-#else
-	UCR |= _BV(RXEN) | _BV(TXEN);
-	UCR |= _BV(RXCIE ); // Enable the USART Recieve Complete interrupt ( USART_RXC )
-#endif
-}
-
-// Sends a single char to the serial port
-void UART_Send_Char(const char c)
-{
-	// If previous char is still being sent then wait until done
-#ifdef ATtiny4313
-	//if (UCSRA & _BV(UDRE))
-	if (_BV(UDRE))
-#else
-	if (_BV(UDRE))
-#endif
-		UDR = c;
-
-	// Send the char and wait for it to finish
-#ifdef ATtiny4313
-	while (( UCSRA & _BV(UDRE)) == 0) {};
-#else
-	while (( USR & _BV(UDRE)) == 0) {};
-#endif
-}
-
-// Sends a string of text from PGM Memory to the serial port
-void SendSTR_P(const char *FlashSTR)
-{
-
-	uint8_t i;
-
-	for (i=0; pgm_read_byte(&FlashSTR[i]); i++)
-		UART_Send_Char(pgm_read_byte(&FlashSTR[i]));
-
-}
-
-// Sends a single char of text to the serial port
-void UART_putc(const char c)
-{
-	UART_Send_Char(c);
-}
-
-// Sends a string of text to the serial port
-void UART_puts(const char *s)
-{
-    register char c;
-
-    while ( (c = *s++) ) {
-        UART_Send_Char(c);
-    }
-	
-}
+/**************************************************************************
+ *
+ * UART.C - ET-JRAVR UART Code
+ * This is a library module that provides UART/USART functions that mimic
+ * some LCD library functions. It can be used to initialize the UART/USART
+ * and to send characters via the USART/UART. Note, the RX ISR is located
+ * in the main module as it interacts with globals.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include "uart.h"
+#include "trace.h"
+#include "latency.h"
+
+//char tbuf[16];
+
+const char HexString[] PROGMEM = "0123456789ABCDEF";
+
+volatile char tx_buf[UART_TX_BUFSIZE];
+volatile uint8_t tx_head = 0;		// next free slot, written by UART_Send_Char
+volatile uint8_t tx_tail = 0;		// next to send, written by the UDRE ISR
+volatile uint8_t tx_high = 0;
+
+#ifdef RS485
+uint8_t EEMEM rs485_addr_ee = 1;
+uint8_t rs485_addr = 1;
+volatile uint8_t rs485_state = RS485_IDLE;
+volatile uint8_t rs485_turn = 0;	// ms left of the turnaround, counted by rs485_tick()
+#endif
+
+void UART_init(const uint8_t baud_rate);
+void UART_Send_Char(const char c);
+void SendSTR_P(const char *FlashSTR);
+void UART_putc(const char c);
+void UART_puts(const char *s);
+void UART_puthex(const uint8_t b);
+
+// Initialize the UART
+void UART_init(const uint8_t baud_rate)
+{
+	uint16_t ubrr;
+
+	// Set up UART, divisors come from F_CPU (see hal.h)
+	switch (baud_rate)
+	{
+		case BR1200:	ubrr = UBRR_1200;	break;
+		case BR2400:	ubrr = UBRR_2400;	break;
+		case BR4800:	ubrr = UBRR_4800;	break;
+		case BR9600:	ubrr = UBRR_9600;	break;
+		case BR14400:	ubrr = UBRR_14400;	break;
+		case BR19200:	ubrr = UBRR_19200;	break;
+		case BR28800:	ubrr = UBRR_28800;	break;
+		case BR38400:	ubrr = UBRR_38400;	break;
+		case BR57600:	ubrr = UBRR_57600;	break;
+		case BR76800:	ubrr = UBRR_76800;	break;
+		case BR115200:	ubrr = UBRR_115200;	break;
+		default:	ubrr = UBRR_9600;	break;
+	}
+
+	HAL_UBRRH = (uint8_t)(ubrr >> 8);
+	HAL_UBRRL = (uint8_t)ubrr;
+
+	// Turn on UART TX and RX
+	HAL_UCSRB |= _BV(HAL_RXEN) | _BV(HAL_TXEN);
+	HAL_UCSRB |= _BV(HAL_RXCIE ); // Enable the USART Recieve Complete interrupt ( USART_RXC )
+
+#ifdef RS485
+	// 9 bit frames, listening for address frames only, bus released
+	rs485_addr = eeprom_read_byte(&rs485_addr_ee);
+	if (rs485_addr == RS485_BROADCAST || rs485_addr >= RS485_ADDR_MAX)
+		rs485_addr = 1;
+
+	RS485_DE_PORT &= ~_BV(RS485_DE_PIN);
+	RS485_DE_DDR |= _BV(RS485_DE_PIN);
+	HAL_UCSRB |= _BV(HAL_UCSZ2);
+	HAL_UCSRA |= _BV(HAL_MPCM);
+#endif
+}
+
+#ifdef RS485
+// Handles a received frame, called by the RX ISR with the 9th bit.
+// Returns 1 if it is data for this unit.
+uint8_t rs485_rx(uint8_t c, uint8_t bit9)
+{
+	uint8_t a = c & ~RS485_POLL;
+
+	if (!bit9)
+		return 1;	// MPCM only lets data through while selected
+
+	if (a == rs485_addr && (c & RS485_POLL))
+	{
+		HAL_UCSRA |= _BV(HAL_MPCM);
+		if (rs485_state == RS485_IDLE)
+		{
+			rs485_turn = RS485_TURN_MS + 1;
+			rs485_state = RS485_TURN;
+		}
+	}
+	else if (c == rs485_addr || c == RS485_BROADCAST)
+		HAL_UCSRA &= ~_BV(HAL_MPCM);
+	else
+		HAL_UCSRA |= _BV(HAL_MPCM);
+
+	return 0;
+}
+
+// Runs the turnaround wait, called from the millisecond tick ISR
+void rs485_tick(void)
+{
+	if (rs485_turn && !--rs485_turn)
+	{
+		RS485_DE_PORT |= _BV(RS485_DE_PIN);
+		rs485_state = RS485_TALK;
+		HAL_UCSRB |= _BV(HAL_UDRIE);
+	}
+}
+
+// Sets and stores this unit's address, ignored if out of range
+void rs485_set_addr(uint8_t a)
+{
+	if (a == RS485_BROADCAST || a >= RS485_ADDR_MAX)
+		return;
+
+	rs485_addr = a;
+	eeprom_update_byte(&rs485_addr_ee, a);
+}
+
+// The end frame has gone out, release the bus
+ISR ( HAL_USART_TX_vect )
+{
+	HAL_UCSRB &= ~_BV(HAL_TXCIE);
+	RS485_DE_PORT &= ~_BV(RS485_DE_PIN);
+	rs485_state = RS485_IDLE;
+}
+#endif
+
+// Feeds UDR from the TX ring, turning itself off when the ring is empty
+ISR ( HAL_USART_UDRE_vect )
+{
+	uint8_t t = tx_tail;
+
+#ifdef RS485
+	// Only while polled, then end with our address and let go of the bus
+	if (rs485_state != RS485_TALK || t == tx_head)
+	{
+		HAL_UCSRB &= ~_BV(HAL_UDRIE);
+		if (rs485_state == RS485_TALK)
+		{
+			rs485_state = RS485_END;
+			HAL_UCSRA = _BV(HAL_MPCM) | _BV(HAL_TXC);	// clear TXC from earlier frames
+			HAL_UCSRB |= _BV(HAL_TXB8) | _BV(HAL_TXCIE);
+			HAL_UDR = rs485_addr;
+		}
+		return;
+	}
+	HAL_UCSRB &= ~_BV(HAL_TXB8);
+#else
+	if (t == tx_head)
+	{
+		HAL_UCSRB &= ~_BV(HAL_UDRIE);
+		return;
+	}
+#endif
+
+	LAT_TX(t);
+	HAL_UDR = tx_buf[t];
+	tx_tail = (t + 1) & (UART_TX_BUFSIZE - 1);
+}
+
+// Queues a single char for the serial port
+void UART_Send_Char(const char c)
+{
+	uint8_t h = tx_head;
+	uint8_t n = (h + 1) & (UART_TX_BUFSIZE - 1);
+	uint8_t used;
+	uint8_t sreg;
+
+	TRACE_EVENT(TR_TX);
+
+	// If the ring is full wait for the ISR to make room. The ring draining
+	// is progress as far as the watchdog is concerned, so long replies
+	// don't trip it; an unpolled RS-485 unit waits as long as it takes.
+	if (n == tx_tail)
+	{
+		while (n == tx_tail)
+		{
+#ifdef RS485
+			if (rs485_state == RS485_IDLE)
+				wdt_reset();
+#endif
+		}
+		wdt_reset();
+	}
+
+	tx_buf[h] = c;
+	tx_head = n;
+
+	used = (n - tx_tail) & (UART_TX_BUFSIZE - 1);
+	if (used > tx_high)
+		tx_high = used;
+
+	// UCSRB is also changed by the ISRs
+	sreg = SREG;
+	cli();
+#ifdef RS485
+	if (rs485_state == RS485_TALK)
+#endif
+	HAL_UCSRB |= _BV(HAL_UDRIE);
+	SREG = sreg;
+}
+
+// Sends a string of text from PGM Memory to the serial port
+void SendSTR_P(const char *FlashSTR)
+{
+
+	uint8_t i;
+
+	for (i=0; pgm_read_byte(&FlashSTR[i]); i++)
+		UART_Send_Char(pgm_read_byte(&FlashSTR[i]));
+
+}
+
+// Sends a single char of text to the serial port
+void UART_putc(const char c)
+{
+	UART_Send_Char(c);
+}
+
+// Sends a string of text to the serial port
+void UART_puts(const char *s)
+{
+    register char c;
+
+    while ( (c = *s++) ) {
+        UART_Send_Char(c);
+    }
+	
+}
+
+// Sends a byte as two hex digits to the serial port
+void UART_puthex(const uint8_t b)
+{
+	UART_Send_Char(pgm_read_byte(&HexString[b >> 4]));
+	UART_Send_Char(pgm_read_byte(&HexString[b & 0x0F]));
+}
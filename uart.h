@@ -1,89 +1,133 @@
-/**************************************************************************
- *
- * UART.H - ET-JRAVR UART Code definitions
- * This is a library module that provides UART/USART functions that mimic
- * some LCD library functions. It can be used to initialize the UART/USART
- * and to send characters via the USART/UART. Note, the RX ISR is located
- * in the main module as it interacts with globals.
- *
- * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
- * All Rights Reserved
- *
- **************************************************************************/
-
-#ifndef __UART_H__
-#define __UART_H__
-
-#include <stdint.h>
-#include <stdlib.h>
-#include <stdio.h>
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
-#include <avr/pgmspace.h>
-
-//extern char tbuf[16];
-
-#define ATtiny4313
-// 2400 UBRR= 207 0.2
-// 4800 UBRR= 103 0.2
-// 9600 UBRR= 51 0.2
-// 14400 UBRR= 34 0.8
-// 19200 UBRR= 25 0.2
-// 28800 UBRR= 16 2.1
-// 38400 UBRR= 12 0.2
-// 57600 UBRR= 8 3.7
-// 76800 UBRR= 6 7.5
-// 115200 UBRR= 3 7.8
-
-// These values are for 8 MHz, 2313
-#define UBRR_1200 	207
-#define UBRR_2400 	207
-#define UBRR_4800 	103
-#define UBRR_9600 	 51
-#define UBRR_14400 	 34
-#define UBRR_19200 	 25
-#define UBRR_28800 	 16
-#define UBRR_38400 	 12
-#define UBRR_57600 	  8
-#define UBRR_76800 	  6
-#define UBRR_115200   3
-
-#define UBRR_1200 	207
-#define UBRR_2400 	207
-#define UBRR_4800 	103
-#define UBRR_9600 	 51
-#define UBRR_14400 	 34
-#define UBRR_19200 	 25
-#define UBRR_28800 	 16
-#define UBRR_38400 	 12
-#define UBRR_57600 	  8
-#define UBRR_76800 	  6
-#define UBRR_115200   3
-
-#ifdef ATtiny4313
-#define UBRR _SFR_IO8(0x009)
-#endif
-
-enum BaudRates {
-	BR1200,
-	BR2400,
-	BR4800,
-	BR9600,
-	BR14400,
-	BR19200,
-	BR28800,
-	BR38400,
-	BR57600,
-	BR76800,
-	BR115200,
-};
-
-void UART_init(const uint8_t baud_rate);
-void UART_Send_Char(const char c);
-void SendSTR_P(const char *FlashSTR);
-void UART_putc(const char c);
-void UART_puts(const char *s);
-
+/**************************************************************************
+ *
+ * UART.H - ET-JRAVR UART Code definitions
+ * This is a library module that provides UART/USART functions that mimic
+ * some LCD library functions. It can be used to initialize the UART/USART
+ * and to send characters via the USART/UART. Note, the RX ISR is located
+ * in the main module as it interacts with globals.
+ *
+ * Sending is interrupt driven: characters go into a ring buffer that the
+ * UDRE interrupt empties, so UART_putc() only waits when the ring is
+ * full. Don't call the send functions with interrupts disabled.
+ *
+ * With RS485 defined the terminal shares a half-duplex RS-485 bus with
+ * other units, using the USART's 9 bit multi-processor mode. Frames
+ * with the 9th bit set are addresses:
+ *
+ *   0aaaaaaa   select unit a for the data frames that follow, or all
+ *              units for a = 0 (broadcast); any other unit stops
+ *              listening
+ *   1aaaaaaa   poll unit a, which deselects it
+ *
+ * Unselected units have MPCM set, so the USART itself drops data frames
+ * meant for other units and they never reach the RX ring. A polled unit
+ * waits RS485_TURN_MS for the host to release the bus, raises its DE/RE
+ * pin, sends what is waiting in the TX ring as data frames and ends with
+ * its own address as an address frame, then drops DE/RE once that has
+ * left the shift register. Nothing is sent until the unit is polled, so
+ * UART_putc() blocks when the ring is full; the host should poll every
+ * unit often. The address is kept in EEPROM and set with ESC 7 a (see
+ * ps2_term.h), sent to one selected unit.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __UART_H__
+#define __UART_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <avr/pgmspace.h>
+
+#include "hal.h"
+
+#ifndef UART_TX_BUFSIZE
+#define UART_TX_BUFSIZE	8	/* TX ring, a power of 2; board profiles raise it */
+#endif
+
+//#define RS485			/* addressed multi-drop operation, see above */
+
+#define RS485_BROADCAST	0
+#define RS485_POLL	0x80	/* address frame bit: poll rather than select */
+#define RS485_ADDR_MAX	0x7F
+#define RS485_TURN_MS	1	/* wait before driving the bus when polled */
+
+#ifndef RS485_DE_PORT
+#define RS485_DE_PORT	PORTD	/* DE and /RE of the transceiver, tied together */
+#define RS485_DE_DDR	DDRD
+#define RS485_DE_PIN	2
+#endif
+
+#define RS485_IDLE	0	/* listening */
+#define RS485_TURN	1	/* polled, waiting RS485_TURN_MS */
+#define RS485_TALK	2	/* driving the bus, sending the TX ring */
+#define RS485_END	3	/* end frame loaded, waiting for it to go out */
+
+//extern char tbuf[16];
+
+// At 8 MHz:
+// 2400 UBRR= 207 0.2
+// 4800 UBRR= 103 0.2
+// 9600 UBRR= 51 0.2
+// 14400 UBRR= 34 0.8
+// 19200 UBRR= 25 0.2
+// 28800 UBRR= 16 2.1
+// 38400 UBRR= 12 0.2
+// 57600 UBRR= 8 3.7
+// 76800 UBRR= 6 7.5
+// 115200 UBRR= 3 7.8
+
+// Worked out from F_CPU, see hal.h
+#define UBRR_1200 	HAL_UBRR(1200)
+#define UBRR_2400 	HAL_UBRR(2400)
+#define UBRR_4800 	HAL_UBRR(4800)
+#define UBRR_9600 	HAL_UBRR(9600)
+#define UBRR_14400 	HAL_UBRR(14400)
+#define UBRR_19200 	HAL_UBRR(19200)
+#define UBRR_28800 	HAL_UBRR(28800)
+#define UBRR_38400 	HAL_UBRR(38400)
+#define UBRR_57600 	HAL_UBRR(57600)
+#define UBRR_76800 	HAL_UBRR(76800)
+#define UBRR_115200 	HAL_UBRR(115200)
+
+enum BaudRates {
+	BR1200,
+	BR2400,
+	BR4800,
+	BR9600,
+	BR14400,
+	BR19200,
+	BR28800,
+	BR38400,
+	BR57600,
+	BR76800,
+	BR115200,
+};
+
+void UART_init(const uint8_t baud_rate);
+void UART_Send_Char(const char c);
+void SendSTR_P(const char *FlashSTR);
+void UART_putc(const char c);
+void UART_puts(const char *s);
+void UART_puthex(const uint8_t b);
+
+extern volatile uint8_t tx_head;	/* Next free TX ring slot */
+extern volatile uint8_t tx_high;	/* Most bytes ever waiting in the TX ring */
+
+#ifdef RS485
+extern uint8_t rs485_addr;		/* This unit's address, 1 to 126 */
+extern volatile uint8_t rs485_state;
+
+uint8_t rs485_rx(uint8_t c, uint8_t bit9);
+void rs485_tick(void);
+void rs485_set_addr(uint8_t a);
+#endif
+
 #endif //UART_H
\ No newline at end of file
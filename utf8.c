@@ -0,0 +1,179 @@
+/**************************************************************************
+ *
+ * UTF8.C - UTF-8 text on the HD44780 character ROM
+ * See utf8.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "utf8.h"
+#include "uart.h"
+
+#ifdef UTF8
+
+typedef struct {
+	uint16_t cp;
+	uint8_t c;
+} utf8_map_t;
+
+// Code points that aren't in a range handled in utf8_rom(), ended by 0
+#ifdef UTF8_ROM_A02
+const utf8_map_t utf8_map[] PROGMEM = {
+	{ 0x2190, 0x1B },	// arrows
+	{ 0x2191, 0x18 },
+	{ 0x2192, 0x1A },
+	{ 0x2193, 0x19 },
+	{ 0x21B5, 0x17 },
+	{ 0x201C, 0x12 },	// double quotes
+	{ 0x201D, 0x13 },
+	{ 0x2264, 0x1C },	// less and greater or equal
+	{ 0x2265, 0x1D },
+	{ 0x25B2, 0x1E },	// triangles
+	{ 0x25B6, 0x10 },
+	{ 0x25BC, 0x1F },
+	{ 0x25C0, 0x11 },
+	{ 0x25CF, 0x16 },	// bullet
+	{ 0, 0 }
+};
+#else
+const utf8_map_t utf8_map[] PROGMEM = {
+	{ 0x00A2, 0xEC },	// cent
+	{ 0x00A5, 0x5C },	// yen, instead of backslash
+	{ 0x00B0, 0xDF },	// degree, really the semi-voiced mark
+	{ 0x00B5, 0xE4 },	// micro
+	{ 0x00B7, 0xA5 },	// middle dot
+	{ 0x00DF, 0xE2 },	// sharp s, as beta
+	{ 0x00E4, 0xE1 },
+	{ 0x00F1, 0xEE },
+	{ 0x00F6, 0xEF },
+	{ 0x00F7, 0xFD },
+	{ 0x00FC, 0xF5 },
+	{ 0x03A3, 0xF6 },	// Greek
+	{ 0x03A9, 0xF4 },
+	{ 0x03B1, 0xE0 },
+	{ 0x03B2, 0xE2 },
+	{ 0x03B5, 0xE3 },
+	{ 0x03B8, 0xF2 },
+	{ 0x03BC, 0xE4 },
+	{ 0x03C0, 0xF7 },
+	{ 0x03C1, 0xE6 },
+	{ 0x03C3, 0xE5 },
+	{ 0x2126, 0xF4 },	// ohm
+	{ 0x2190, 0x7F },	// arrows, instead of DEL and tilde
+	{ 0x2192, 0x7E },
+	{ 0x221A, 0xE8 },	// square root
+	{ 0x221E, 0xF3 },	// infinity
+	{ 0x2588, 0xFF },	// full block
+	{ 0x3001, 0xA4 },	// CJK punctuation
+	{ 0x3002, 0xA1 },
+	{ 0x300C, 0xA2 },
+	{ 0x300D, 0xA3 },
+	{ 0x30FB, 0xA5 },
+	{ 0x4E07, 0xFB },	// kanji for 10000, 1000 and yen
+	{ 0x5343, 0xFA },
+	{ 0x5186, 0xFC },
+	{ 0, 0 }
+};
+#endif
+
+uint8_t utf8_more = 0;		// continuation bytes still to come
+uint16_t utf8_cp;		// code point so far
+
+// Maps a code point from U+0080 up to a ROM code, UTF8_BAD if there's none
+unsigned char utf8_rom(uint16_t cp)
+{
+	const utf8_map_t *m;
+	uint16_t n;
+
+	if (cp < 0x80)
+		return UTF8_BAD;		// overlong encoding
+#ifdef UTF8_ROM_A02
+	if (cp >= 0xA0 && cp <= 0xFF)
+		return cp;
+#else
+	// Half width katakana, in JIS X 0201 order
+	if (cp >= 0xFF61 && cp <= 0xFF9F)
+		return cp - (0xFF61 - 0xA1);
+#endif
+
+	for (m = utf8_map; (n = pgm_read_word(&m->cp)); m++)
+		if (n == cp)
+			return pgm_read_byte(&m->c);
+	return UTF8_BAD;
+}
+
+// Takes the next byte of host text. Returns the ROM code to display,
+// or 0 while a sequence isn't complete yet.
+unsigned char utf8_rx(unsigned char c)
+{
+	unsigned char r;
+
+	if (c < 0x80)
+	{
+		utf8_more = 0;
+		return c;
+	}
+
+	if (c < 0xC0)
+	{
+		if (!utf8_more)
+			return UTF8_BAD;		// stray continuation byte
+		if (utf8_cp != UTF8_NONE)
+		{
+			utf8_cp = (utf8_cp << 6) | (c & 0x3F);
+
+			// Two bytes into three: overlong forms of U+0000-07FF and
+			// the UTF-16 surrogates U+D800-DFFF are not characters
+			if (utf8_more == 2 && (utf8_cp < (0x800 >> 6) ||
+			    (utf8_cp >= (0xD800 >> 6) && utf8_cp <= (0xDFFF >> 6))))
+				utf8_cp = UTF8_NONE;
+		}
+		if (--utf8_more)
+			return 0;
+		return utf8_rom(utf8_cp);
+	}
+
+	// A lead byte, the one before it didn't get its continuation
+	r = utf8_more ? UTF8_BAD : 0;
+
+	if (c < 0xE0)
+	{
+		utf8_more = 1;
+		utf8_cp = c & 0x1F;
+	}
+	else if (c < 0xF0)
+	{
+		utf8_more = 2;
+		utf8_cp = c & 0x0F;
+	}
+	else if (c < 0xF8)
+	{
+		utf8_more = 3;
+		utf8_cp = UTF8_NONE;
+	}
+	else
+	{
+		utf8_more = 0;
+		r = UTF8_BAD;
+	}
+	return r;
+}
+
+// Sends a Latin-1 character to the host as UTF-8
+void utf8_putc(unsigned char c)
+{
+	if (c < 0x80)
+	{
+		UART_putc(c);
+		return;
+	}
+	UART_putc(0xC0 | (c >> 6));
+	UART_putc(0x80 | (c & 0x3F));
+}
+
+#endif
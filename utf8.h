@@ -0,0 +1,55 @@
+/**************************************************************************
+ *
+ * UTF8.H - UTF-8 text on the HD44780 character ROM
+ * Host text is decoded one byte at a time, with three bytes of state,
+ * and each character is mapped onto a code of the display's character
+ * ROM, so it takes one cell and one LCD write whatever its length in
+ * UTF-8. Characters the ROM hasn't got show as UTF8_BAD, as do broken
+ * sequences, overlong ones and surrogates. Code points past U+FFFF are
+ * never in the ROM.
+ *
+ * ASCII is passed through unchanged, control codes included. A sequence
+ * cut off by an ASCII byte is dropped, one cut off by another lead byte
+ * shows as UTF8_BAD.
+ *
+ * The keymaps give Latin-1, so keys from U+0080 up are sent to the host
+ * as two byte UTF-8, and echoed through the same ROM mapping.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __UTF8_H__
+#define __UTF8_H__
+
+#include <stdint.h>
+
+#include "hal.h"
+
+//#define UTF8		/* decode host text as UTF-8, the mega profiles do */
+
+// Character ROM of the display, see the HD44780U data sheet: A00 has
+// katakana and some Greek and maths symbols, A02 has Latin-1 in its
+// upper half and arrows at 0x10-0x1F.
+
+#define UTF8_ROM_A00
+//#define UTF8_ROM_A02
+
+#ifdef UTF8_ROM_A02
+#define UTF8_BAD	0xBF	/* inverted question mark */
+#else
+#define UTF8_BAD	0xFF	/* solid block */
+#endif
+
+#define UTF8_NONE	0xFFFF	/* code point past U+FFFF, or no character */
+
+#ifdef UTF8
+
+unsigned char utf8_rx(unsigned char c);
+unsigned char utf8_rom(uint16_t cp);
+void utf8_putc(unsigned char c);
+
+#endif
+
+#endif //__UTF8_H__
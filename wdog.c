@@ -0,0 +1,47 @@
+/**************************************************************************
+ *
+ * WDOG.C - Watchdog supervision and warm restart
+ * See wdog.h.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include "wdog.h"
+
+extern uint8_t __noinit_start;		// from the linker script
+extern uint8_t __noinit_end;
+
+uint8_t wdog_cause NOINIT;
+uint8_t wdog_resets NOINIT;
+uint8_t wdog_warm NOINIT;
+uint16_t wdog_magic NOINIT;
+
+void wdog_boot(void) __attribute__ ((naked, used, section (".init3")));
+
+// Runs from .init3, before .data and .bss are set up. The watchdog stays
+// on after it has reset the MCU, so turn it off before it fires again.
+void wdog_boot(void)
+{
+	uint8_t *p;
+
+	if ((MCUSR & _BV(WDRF)) && wdog_magic == WDOG_MAGIC)
+	{
+		wdog_warm = 1;
+		wdog_resets++;
+	}
+	else
+	{
+		for (p = &__noinit_start; p < &__noinit_end; p++)
+			*p = 0;
+		wdog_magic = WDOG_MAGIC;
+	}
+
+	wdog_cause = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
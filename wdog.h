@@ -0,0 +1,41 @@
+/**************************************************************************
+ *
+ * WDOG.H - Watchdog supervision definitions
+ * The watchdog is kicked by sched_run() only when the millisecond tick
+ * has moved on since the last kick, so a wedged main loop or a dead
+ * tick ISR both end in a watchdog reset. Waiting on the serial port
+ * counts as progress while the TX ring is draining.
+ *
+ * Variables marked NOINIT (see hal.h) live in .noinit, which the C
+ * runtime leaves alone: the display shadow and cursor, the echo and LF
+ * settings, and the statistics counters. After a power-on or external
+ * reset wdog_boot() clears the whole section, so they start at 0 like
+ * any other variable. After a watchdog reset they are kept, and main()
+ * skips the sign-on and redraws the display from the shadow instead.
+ *
+ * The reset cause (MCUSR) and the number of watchdog resets are
+ * reported by ESC CMD_STATS.
+ *
+ * (C) 2012 KB4OID Labs, A division of Kodetroll Industries
+ * All Rights Reserved
+ *
+ **************************************************************************/
+
+#ifndef __WDOG_H__
+#define __WDOG_H__
+
+#include <stdint.h>
+
+#include <avr/wdt.h>
+#include "hal.h"
+
+#define WDOG_TIMEOUT	WDTO_500MS
+#define WDOG_MAGIC	0x5a3c		/* .noinit holds state from before a reset */
+
+extern uint8_t wdog_cause;		/* MCUSR at the last reset */
+extern uint8_t wdog_resets;		/* watchdog resets since power-up */
+extern uint8_t wdog_warm;		/* 1 if .noinit survived a watchdog reset */
+
+#define wdog_start()	wdt_enable(WDOG_TIMEOUT)
+
+#endif //__WDOG_H__